@@ -4,18 +4,54 @@
 #include "Pathfinding.h"
 #include "NodeMap.h"
 #include "PathAgent.h"
+#include "Benchmarks.h"
+#include "PathfindingService.h"
+#include "PathTask.h"
 #include <string>
 #include <iostream>
 #include <glm/glm.hpp>
-#include <thread>
-#include <mutex>
-#include <atomic>
 #include <ctime>
+#include <chrono>
+#include <functional>
 
 using namespace AIForGames;
 
+// The wanderer's behaviour as a coroutine. It suspends while its path is searched on a worker
+// and while it walks, and the frame loop resumes it from DispatchCompleted() and
+// PathAgent::Update(), so it needs no state machine and no flags of its own
+PathTask Wander(PathAgent& wanderer, NodeMap& nodeMap, PathfindingService& pathService, const std::function<PathRequestOptions(const PathAgent&)>& requestOptions)
+{
+    for (;;) {
+        co_await wanderer.Arrival(); // Finish any walk already under way
+
+        NodeHandle start = wanderer.GetCurrentNode();
+        if (start == InvalidNode) {
+            // Assign a starting node only once if it was never set
+            start = GetRandomValidNode(nodeMap);
+            wanderer.SetNode(start);
+        }
+
+        NodeHandle end = GetRandomValidNode(nodeMap);
+        if (start == InvalidNode || end == InvalidNode) {
+            co_return; // Nowhere walkable to wander to
+        }
+        glm::ivec2 from = nodeMap.GetNodeCoords(start);
+        glm::ivec2 to = nodeMap.GetNodeCoords(end);
+        std::cout << "[WANDERER] Requesting path from " << from.x << "," << from.y
+            << " to " << to.x << "," << to.y << "\n";
+
+        WaypointPath path = co_await pathService.Find(start, end, requestOptions(wanderer));
+        wanderer.SetPath(std::move(path), true);
+    }
+}
+
 int main(int argc, char* argv[])
 {
+    // Headless mode: AIE_Starter.exe --benchmark <name> runs a benchmark and exits without opening a window
+    if (argc >= 3 && std::string(argv[1]) == "--benchmark") {
+        return RunBenchmark(argv[2]);
+    }
+
     srand((unsigned int)time(nullptr));  // Seed random number generator
 
     int screenWidth = 1200;
@@ -46,34 +82,56 @@ int main(int argc, char* argv[])
 
     NodeMap nodeMap;
     nodeMap.Initialise(asciiMap, 50); // Build the node map using ASCII layout
+    nodeMap.SetPathCacheCapacity(256 * 1024); // Wanderers and repeated clicks revisit the same routes
+    nodeMap.SetSubpathCacheCapacity(512 * 1024); // Wanderers often set off from a point on an earlier route
 
-    Node* startNode = nodeMap.GetNode(1, 1);
-    Node* endNode = nodeMap.GetNode(10, 2);
+    NodeHandle startNode = nodeMap.GetNode(1, 1);
+    NodeHandle endNode = nodeMap.GetNode(10, 2);
 
-    PathAgent agent; // Player controlled agent (green)
+    PathAgent agent(nodeMap); // Player controlled agent (green)
     agent.SetNode(startNode);
     agent.SetSpeed(64);
 
-    std::vector<Node*> nodeMapPath = nodeMap.AStarSearch(startNode, endNode); // Initial path
-    agent.GoToNode(endNode, nodeMap, false);
+    agent.GoToNode(endNode, false); // Initial path
 
-    // Multithreading for Player Agent
-    std::thread pathfindingThread;
-    std::mutex pathMutex;
-    std::atomic<bool> isPathfinding(false);
-    std::atomic<bool> newPathAvailable(false);
-    std::vector<Node*> computedPath;
-
-    // Wanderer Agent and its Thread
-    PathAgent wanderer; // Blue autonomous agent
+    // Wanderer Agent
+    PathAgent wanderer(nodeMap); // Blue autonomous agent
     wanderer.SetSpeed(64);
-    bool isWandering = false;
-    bool wandererNeedsNewPath = false;
-    std::thread wandererThread;
-    std::mutex wandererMutex;
-    std::vector<Node*> wandererPath;
-    std::atomic<bool> wandererPathReady = false;
-    std::atomic<bool> wandererIsCalculating = false;
+
+    // Searches run on a fixed pool of worker threads; finished paths are handed to the agents
+    // on this thread once per frame. Declared after the agents so it stops before they go away
+    PathfindingService pathService(nodeMap);
+    std::cout << "[SYSTEM] Pathfinding service started with " << pathService.GetWorkerCount() << " worker threads.\n";
+
+    // Scheduling: player commands should arrive within a few frames, wanderers can wait.
+    // Agents outside the window are searched after visible ones of the same class. Each new
+    // request for an agent cancels its previous one, so clicks are never ignored or queued up
+    auto requestOptions = [&](const PathAgent& requester, PathPriority priority, std::chrono::milliseconds budget) {
+        glm::vec2 position = requester.GetPosition();
+        PathRequestOptions options;
+        options.priority = priority;
+        options.deadline = PathClock::now() + budget;
+        options.onScreen = position.x >= 0.0f && position.y >= 0.0f && position.x < screenWidth && position.y < screenHeight;
+        return options;
+    };
+    auto requestPlayerPath = [&]() {
+        agent.RequestPath(pathService, endNode, requestOptions(agent, PathPriority::Player, std::chrono::milliseconds(50)));
+    };
+    std::function<PathRequestOptions(const PathAgent&)> wandererOptions = [&](const PathAgent& requester) {
+        return requestOptions(requester, PathPriority::Background, std::chrono::milliseconds(500));
+    };
+
+    // Running wanderer coroutine; empty while wandering is off. Declared after the service and
+    // agents so it is destroyed first
+    PathTask wandering;
+
+    // Memory report: M toggles the on-screen overlay, and the report is printed on shutdown
+    bool showMemoryOverlay = false;
+    auto buildMemoryReport = [&]() {
+        MemoryReport report = nodeMap.GetMemoryReport();
+        report.agentPathBytes = agent.GetMemoryUsage() + wanderer.GetMemoryUsage();
+        return report;
+    };
 
     float time = (float)GetTime();
     float deltaTime;
@@ -89,84 +147,50 @@ int main(int argc, char* argv[])
         agent.Update(deltaTime);
         wanderer.Update(deltaTime);
 
-        // Toggle wandering on W key
-        if (IsKeyPressed(KEY_W)) {
-            isWandering = !isWandering;
-            std::cout << "[WANDERER] Wandering " << (isWandering ? "started.\n" : "stopped.\n");
-
-            if (!isWandering && wandererThread.joinable()) {
-                wandererThread.join();
-            }
+        // Toggle the memory overlay on M key
+        if (IsKeyPressed(KEY_M)) {
+            showMemoryOverlay = !showMemoryOverlay;
         }
 
-        // When wanderer needs a new path
-        if (isWandering && wanderer.m_path.empty() && !wandererNeedsNewPath && !wandererIsCalculating) {
-            wandererNeedsNewPath = true;
-        }
-
-        if (isWandering && wandererNeedsNewPath && !wandererIsCalculating) {
-            wandererNeedsNewPath = false;
-            wandererIsCalculating = true;
-
-            Node* start = wanderer.GetCurrentNode();
-            if (!start) {
-                // Assign a starting node only once if it was never set
-                start = GetRandomValidNode(nodeMap, 12, 8);
-                wanderer.SetNode(start);
+        // T toggles the wall under the mouse. The edit is published as a new map version;
+        // searches already running on worker threads finish on the version they started with
+        if (IsKeyPressed(KEY_T)) {
+            Vector2 mousePos = GetMousePosition();
+            int x = static_cast<int>(mousePos.x / nodeMap.GetCellSize());
+            int y = static_cast<int>(mousePos.y / nodeMap.GetCellSize());
+            NodeHandle node = nodeMap.GetNode(x, y);
+            bool walkable = node == InvalidNode;
+            if (!nodeMap.GetLayout().Contains(x, y)) {
+                std::cerr << "Error: Clicked position is out of bounds." << std::endl;
+            }
+            else if (!walkable && (node == agent.GetCurrentNode() || node == wanderer.GetCurrentNode() || node == endNode)) {
+                std::cout << "[EDIT] Cannot place a wall on an agent or its destination.\n";
+            }
+            else {
+                std::uint64_t version = nodeMap.ApplyEdits({ { x, y, walkable } });
+                std::cout << "[EDIT] Cell " << x << "," << y << " is now " << (walkable ? "open" : "a wall")
+                    << " (map version " << version << ").\n";
             }
-
-            Node* end = GetRandomValidNode(nodeMap, 12, 8);
-
-            wandererThread = std::thread([&, start, end]() {
-                std::cout << "[WANDERER] Searching path from " << start->position.x << "," << start->position.y
-                    << " to " << end->position.x << "," << end->position.y << " in thread ID: "
-                    << std::this_thread::get_id() << "\n";
-
-                auto path = nodeMap.AStarSearch(start, end);
-
-                std::lock_guard<std::mutex> lock(wandererMutex);
-                wandererPath = path;
-                wandererPathReady = true;
-                });
         }
 
-		// Apply wanderer's path if ready
-        if (wandererPathReady) {
-            std::lock_guard<std::mutex> lock(wandererMutex);
-            wanderer.GoToNode(wandererPath.back(), nodeMap, true);
-            wanderer.m_path = wandererPath;
-            wandererPathReady = false;
-
-            if (wandererThread.joinable())
-                wandererThread.join();
-
-            wandererIsCalculating = false;
+        // Toggle wandering on W key. Stopping destroys the coroutine, which cancels any search
+        // it is waiting for; the wanderer still finishes the walk it is on
+        if (IsKeyPressed(KEY_W)) {
+            bool isWandering = wandering.IsDone();
+            std::cout << "[WANDERER] Wandering " << (isWandering ? "started.\n" : "stopped.\n");
+            wandering = isWandering ? Wander(wanderer, nodeMap, pathService, wandererOptions) : PathTask();
         }
 
         // Left click: Set new start node for player agent
-        if (IsMouseButtonPressed(0) && !isPathfinding)
+        if (IsMouseButtonPressed(0))
         {
             Vector2 mousePos = GetMousePosition();
-            Node* selected = nodeMap.GetClosestNode(glm::vec2(mousePos.x, mousePos.y));
-            if (selected) {
+            NodeHandle selected = nodeMap.GetClosestNode(glm::vec2(mousePos.x, mousePos.y));
+            if (selected != InvalidNode) {
                 startNode = selected;
                 agent.SetNode(startNode);
-                std::cout << "[INPUT] Start node set. Launching pathfinding thread.\n";
-
-                if (pathfindingThread.joinable()) {
-                    std::cout << "[THREAD] Joining previous pathfinding thread.\n";
-                    pathfindingThread.join();
-                }
-
-                isPathfinding = true;
-                pathfindingThread = std::thread([&]() {
-                    std::cout << "[THREAD] A* pathfinding started...\n";
-                    auto path = nodeMap.AStarSearch(startNode, endNode);
-                    std::lock_guard<std::mutex> lock(pathMutex);
-                    computedPath = path;
-                    newPathAvailable = true;
-                    isPathfinding = false;
-                    });
+                std::cout << "[INPUT] Start node set. Requesting path.\n";
+                requestPlayerPath();
             }
         }
 
@@ -174,56 +198,39 @@ int main(int argc, char* argv[])
         if (IsMouseButtonPressed(1))
         {
             Vector2 mousePos = GetMousePosition();
-            Node* selected = nodeMap.GetClosestNode(glm::vec2(mousePos.x, mousePos.y));
-            if (selected) {
+            NodeHandle selected = nodeMap.GetClosestNode(glm::vec2(mousePos.x, mousePos.y));
+            if (selected != InvalidNode) {
                 endNode = selected;
-                std::cout << "[INPUT] End node set. Launching pathfinding thread.\n";
-
-                if (!isPathfinding && startNode != nullptr) {
-                    if (pathfindingThread.joinable()) {
-                        std::cout << "[THREAD] Joining previous pathfinding thread.\n";
-                        pathfindingThread.join();
-                    }
-
-                    isPathfinding = true;
-                    pathfindingThread = std::thread([&]() {
-                        std::cout << "[PLAYER] A* pathfinding started in thread ID: " << std::this_thread::get_id() << "\n";
-                        auto path = nodeMap.AStarSearch(startNode, endNode);
-                        std::lock_guard<std::mutex> lock(pathMutex);
-                        computedPath = path;
-                        newPathAvailable = true;
-                        isPathfinding = false;
-                        });
+                std::cout << "[INPUT] End node set. Requesting path.\n";
+
+                if (startNode != InvalidNode) {
+                    requestPlayerPath();
                 }
             }
         }
 
-		// Apply computed path to agent if available
-        if (newPathAvailable && !isPathfinding)
-        {
-            std::lock_guard<std::mutex> lock(pathMutex);
-            std::cout << "[MAIN] Applying computed path to agent.\n";
-            nodeMapPath = computedPath;
-            agent.GoToNode(endNode, nodeMap, false);
-            newPathAvailable = false;
-        }
+        // Hand finished searches to their agents
+        pathService.DispatchCompleted();
 
         // Render everything
         BeginDrawing();
         ClearBackground(BLACK);
         nodeMap.Draw();
-        nodeMap.DrawPath(nodeMapPath, WHITE);
+        // While a new path is being searched, the route still being walked is drawn greyed out
+        nodeMap.DrawPath(agent.GetPath(), agent.IsAwaitingPath() ? GRAY : WHITE);
         agent.Draw(GREEN);
         wanderer.Draw(BLUE);
+        if (showMemoryOverlay) {
+            DrawRectangle(5, 5, 270, 190, Color{ 0, 0, 0, 200 });
+            buildMemoryReport().Draw(15, 15, 20, RAYWHITE);
+        }
         EndDrawing();
     }
 
-    // Join threads before shutdown
-    if (pathfindingThread.joinable())
-        pathfindingThread.join();
-    if (wandererThread.joinable())
-        wandererThread.join();
-
+    buildMemoryReport().Print(std::cout);
+    pathService.GetStats().Print(std::cout);
+    nodeMap.GetPathCacheStats().Print(std::cout);
+    nodeMap.GetSubpathCacheStats().Print(std::cout);
     std::cout << "[SYSTEM] Game shutting down.\n";
     CloseWindow();
     return 0;
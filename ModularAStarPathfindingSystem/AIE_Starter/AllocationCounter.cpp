@@ -0,0 +1,81 @@
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace AIForGames;
+
+#ifdef AIFORGAMES_COUNT_ALLOCATIONS
+
+namespace {
+    std::atomic<size_t> g_allocations{ 0 }; // Heap allocations made through operator new
+}
+
+bool AIForGames::IsCountingAllocations() {
+    return true;
+}
+
+size_t AIForGames::GetAllocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+// Counting replacements of the global allocation functions. The other forms (arrays, nothrow)
+// forward to these by default. They live alone in this file, so no new-expression is ever
+// compiled next to them and the compiler cannot mix up which allocator a pointer came from.
+// Every pointer is released with the function matching the one that allocated it
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size > 0 ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    if (void* memory = _aligned_malloc(size > 0 ? size : 1, align)) return memory;
+#else
+    if (void* memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) return memory;
+#endif
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+#else
+
+bool AIForGames::IsCountingAllocations() {
+    return false;
+}
+
+size_t AIForGames::GetAllocationCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+
+namespace AIForGames {
+
+    // Counts heap allocations made through the global operator new, for the alloc benchmark.
+    // The counting replacements of operator new and delete are only compiled in when the build
+    // defines AIFORGAMES_COUNT_ALLOCATIONS; other builds keep the standard allocator untouched
+    // and never count anything.
+    bool IsCountingAllocations(); // True if this build replaces operator new with the counting one
+    size_t GetAllocationCount(); // Allocations made so far; always 0 unless counting
+}
@@ -0,0 +1,948 @@
+#include "Benchmarks.h"
+#include "AllocationCounter.h"
+#include "NodeMap.h"
+#include "MemoryReport.h"
+#include "WorkerPool.h"
+#include "SearchContext.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace AIForGames;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double MillisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Deterministic pseudo-random terrain. The map is divided into 16x16 blocks, each holding
+    // one rectangular "building" of wall with open streets around it, so every walkable cell is
+    // reachable. The top-right quarter and every 16th chunk are solid wall, which exercises
+    // chunk elision without cutting the open area into pieces
+    bool LargeMapTerrain(int x, int y, int size) {
+        if (x >= size / 2 && y < size / 2) return false;
+        int chunkX = x >> GridLayout::ChunkShift;
+        int chunkY = y >> GridLayout::ChunkShift;
+        if ((chunkX * 7 + chunkY * 3) % 16 == 0) return false;
+
+        std::uint32_t hash = static_cast<std::uint32_t>(x >> 4) * 73856093u ^ static_cast<std::uint32_t>(y >> 4) * 19349663u;
+        hash ^= hash >> 13;
+        hash *= 0x5bd1e995u;
+        hash ^= hash >> 15;
+        int buildingWidth = 4 + static_cast<int>(hash % 9);
+        int buildingHeight = 4 + static_cast<int>((hash >> 8) % 9);
+        int blockX = x & 15;
+        int blockY = y & 15;
+        return blockX < 2 || blockX >= 2 + buildingWidth || blockY < 2 || blockY >= 2 + buildingHeight;
+    }
+
+    // Picks a random walkable node within radius cells of (x, y), or anywhere when radius is 0
+    NodeHandle RandomNodeNear(const NodeMap& nodeMap, std::mt19937& rng, int x, int y, int radius) {
+        for (;;) {
+            int nodeX = radius > 0 ? x + static_cast<int>(rng() % (2 * radius + 1)) - radius : static_cast<int>(rng() % nodeMap.GetWidth());
+            int nodeY = radius > 0 ? y + static_cast<int>(rng() % (2 * radius + 1)) - radius : static_cast<int>(rng() % nodeMap.GetHeight());
+            NodeHandle node = nodeMap.GetNode(nodeX, nodeY);
+            if (node != InvalidNode) return node;
+        }
+    }
+
+    // Loads a 16384 x 16384 map with lazy chunk construction, then runs local and
+    // cross-map queries. Fails if the map and search memory exceed the stated budget
+    int LargeMapBenchmark() {
+        const int mapSize = 16384;
+        const int localQueries = 200;
+        const int localRadius = 512;
+        const int longQueries = 4;
+        const size_t memoryBudget = size_t(1) << 30; // 1 GB for map, edges and search scratch
+
+        std::cout << "[BENCHMARK] large-map: " << mapSize << "x" << mapSize << " cells, budget "
+            << (memoryBudget >> 20) << " MB\n";
+
+        NodeMap nodeMap;
+        Clock::time_point start = Clock::now();
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, true);
+        std::cout << "[BENCHMARK] Load: " << MillisecondsSince(start) << " ms, "
+            << nodeMap.GetAllocatedChunkCount() << " of " << nodeMap.GetLayout().ChunkCount() << " chunks stored\n";
+
+        std::mt19937 rng(12345);
+        std::vector<NodeHandle> path;
+        size_t found = 0;
+
+        start = Clock::now();
+        for (int i = 0; i < localQueries; i++) {
+            NodeHandle from = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            glm::ivec2 coords = nodeMap.GetNodeCoords(from);
+            NodeHandle to = RandomNodeNear(nodeMap, rng, coords.x, coords.y, localRadius);
+            nodeMap.AStarSearch(from, to, path);
+            found += path.empty() ? 0 : 1;
+        }
+        std::cout << "[BENCHMARK] " << localQueries << " local queries (radius " << localRadius << "): "
+            << MillisecondsSince(start) / localQueries << " ms average, " << found << " found\n";
+
+        // Corner to corner through the open bottom-left half of the map
+        found = 0;
+        start = Clock::now();
+        for (int i = 0; i < longQueries; i++) {
+            NodeHandle from = RandomNodeNear(nodeMap, rng, 600, mapSize / 2 + 600, 500);
+            NodeHandle to = RandomNodeNear(nodeMap, rng, mapSize - 600, mapSize - 600, 500);
+            nodeMap.AStarSearch(from, to, path);
+            found += path.empty() ? 0 : 1;
+        }
+        std::cout << "[BENCHMARK] " << longQueries << " long queries: " << MillisecondsSince(start) / longQueries
+            << " ms average, " << found << " found, last path " << path.size() << " nodes\n";
+
+        MemoryReport report = nodeMap.GetMemoryReport();
+        report.Print(std::cout);
+        std::cout << "[BENCHMARK] Chunks built: " << nodeMap.GetBuiltChunkCount() << "\n";
+
+        // The total includes the search scratch still held after the queries. Every search ran on
+        // this thread, so only its context holds any, and the long queries must not have left
+        // more than the retention limit behind
+        size_t retentionLimit = SearchContext::GetRetentionLimit();
+        bool withinBudget = report.Total() <= memoryBudget;
+        bool scratchReleased = report.searchScratchBytes <= retentionLimit;
+        std::cout << "[BENCHMARK] Search scratch retained: " << (report.searchScratchBytes >> 20) << " MB of "
+            << (retentionLimit >> 20) << " MB limit\n";
+        std::cout << "[BENCHMARK] " << (withinBudget && scratchReleased ? "PASS" : "FAIL") << ": " << (report.Total() >> 20)
+            << " MB used of " << (memoryBudget >> 20) << " MB budget\n";
+        return withinBudget && scratchReleased ? 0 : 1;
+    }
+
+    // Answers the same batch of independent queries one by one on this thread, then with
+    // SearchBatch() on every core, and checks both give paths of the same length
+    int BatchBenchmark() {
+        const int mapSize = 1024;
+        const size_t queryCount = 4096;
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        // A mix of short and long queries, so some workers run dry and have to steal
+        std::mt19937 rng(54321);
+        std::vector<PathQuery> queries(queryCount);
+        for (size_t i = 0; i < queryCount; i++) {
+            queries[i].start = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            glm::ivec2 coords = nodeMap.GetNodeCoords(queries[i].start);
+            queries[i].goal = i % 8 == 0 ? RandomNodeNear(nodeMap, rng, 0, 0, 0) : RandomNodeNear(nodeMap, rng, coords.x, coords.y, 32);
+        }
+
+        std::cout << "[BENCHMARK] batch: " << queryCount << " queries on " << mapSize << "x" << mapSize << " cells, "
+            << WorkerPool::Shared().GetWorkerCount() << " workers\n";
+
+        std::vector<PathResult> serial(queryCount);
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < queryCount; i++) {
+            serial[i].status = nodeMap.AStarSearch(queries[i].start, queries[i].goal, serial[i].path);
+        }
+        double serialMs = MillisecondsSince(start);
+
+        // The first batch warms up every worker's SearchContext; the second is timed
+        std::vector<PathResult> parallel(queryCount);
+        nodeMap.SearchBatch(queries, parallel);
+        start = Clock::now();
+        nodeMap.SearchBatch(queries, parallel);
+        double parallelMs = MillisecondsSince(start);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < queryCount; i++) {
+            if (serial[i].status != parallel[i].status || serial[i].path.size() != parallel[i].path.size()) mismatches++;
+        }
+
+        std::cout << "[BENCHMARK] Serial: " << serialMs << " ms, SearchBatch: " << parallelMs << " ms, speedup "
+            << serialMs / parallelMs << "x\n";
+        std::cout << "[BENCHMARK] " << (mismatches == 0 ? "PASS" : "FAIL") << ": " << mismatches << " results differ from the serial search\n";
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    // Loads and fully builds the same map on pools of 1, 2, 4, ... threads up to the hardware
+    // count, and reports the speedup of each over the single-threaded load
+    int LoadBenchmark() {
+        const int mapSize = 4096;
+        unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::cout << "[BENCHMARK] load: " << mapSize << "x" << mapSize << " cells, eager build, up to " << maxThreads << " threads\n";
+
+        double singleThreadMs = 0.0;
+        size_t expectedChunks = 0;
+        bool consistent = true;
+        for (unsigned int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            WorkerPool pool(threads);
+            NodeMap nodeMap;
+            Clock::time_point start = Clock::now();
+            nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false, pool);
+            double loadMs = MillisecondsSince(start);
+
+            if (threads == 1) {
+                singleThreadMs = loadMs;
+                expectedChunks = nodeMap.GetBuiltChunkCount();
+            }
+            consistent = consistent && nodeMap.GetBuiltChunkCount() == expectedChunks;
+            std::cout << "[BENCHMARK] " << threads << " threads: " << loadMs << " ms, speedup " << singleThreadMs / loadMs
+                << "x, " << nodeMap.GetBuiltChunkCount() << " chunks built\n";
+            if (threads == maxThreads) break;
+        }
+
+        std::cout << "[BENCHMARK] " << (consistent ? "PASS" : "FAIL") << ": every thread count built the same chunks\n";
+        return consistent ? 0 : 1;
+    }
+
+    // Times long cross-map queries with the serial search, then with the hash-distributed
+    // parallel search on pools of 1, 2, 4, ... threads, and checks every path is as short
+    int ParallelSearchBenchmark() {
+        const int mapSize = 8192;
+        const int queryCount = 4;
+        unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::cout << "[BENCHMARK] parallel-search: " << queryCount << " corner-to-corner queries on " << mapSize << "x" << mapSize
+            << " cells, up to " << maxThreads << " threads\n";
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, true);
+
+        // Through the open bottom-left half of the map, as in the large-map benchmark
+        std::mt19937 rng(2468);
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = RandomNodeNear(nodeMap, rng, 300, mapSize / 2 + 300, 250);
+            query.goal = RandomNodeNear(nodeMap, rng, mapSize - 300, mapSize - 300, 250);
+        }
+
+        std::shared_ptr<const MapSnapshot> snapshot = nodeMap.GetSnapshot();
+        std::vector<size_t> serialLengths;
+        std::vector<NodeHandle> path;
+        Clock::time_point start = Clock::now();
+        for (const PathQuery& query : queries) {
+            nodeMap.AStarSearch(*snapshot, query.start, query.goal, path);
+            serialLengths.push_back(path.size());
+        }
+        double serialMs = MillisecondsSince(start) / queryCount;
+        std::cout << "[BENCHMARK] Serial: " << serialMs << " ms per query\n";
+
+        size_t mismatches = 0;
+        for (unsigned int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            WorkerPool pool(threads);
+            start = Clock::now();
+            for (size_t i = 0; i < queries.size(); i++) {
+                nodeMap.AStarSearch(*snapshot, queries[i].start, queries[i].goal, path, pool);
+                mismatches += path.size() == serialLengths[i] ? 0 : 1;
+            }
+            double parallelMs = MillisecondsSince(start) / queryCount;
+            std::cout << "[BENCHMARK] " << threads << " threads: " << parallelMs << " ms per query, speedup " << serialMs / parallelMs << "x\n";
+            if (threads == maxThreads) break;
+        }
+
+        std::cout << "[BENCHMARK] " << (mismatches == 0 ? "PASS" : "FAIL") << ": " << mismatches << " paths longer than the serial search's\n";
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    // Runs the same set of independent queries on pools of 1, 2, 4, ... threads up to the
+    // hardware count and reports query throughput. Each thread searches with its own context
+    // and statistics block, so throughput should grow linearly with the thread count
+    int ScalingBenchmark() {
+        const int mapSize = 2048;
+        const size_t queryCount = 8192;
+        unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        std::mt19937 rng(97531);
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            glm::ivec2 coords = nodeMap.GetNodeCoords(query.start);
+            query.goal = RandomNodeNear(nodeMap, rng, coords.x, coords.y, 64);
+        }
+
+        std::cout << "[BENCHMARK] scaling: " << queryCount << " queries on " << mapSize << "x" << mapSize << " cells, up to "
+            << maxThreads << " threads\n";
+
+        std::shared_ptr<const MapSnapshot> snapshot = nodeMap.GetSnapshot();
+        std::vector<PathResult> results(queryCount);
+        double singleThreadRate = 0.0;
+        for (unsigned int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            WorkerPool pool(threads);
+            auto runQueries = [&]() {
+                pool.ParallelFor(queryCount, [&](size_t index, unsigned int) {
+                    results[index].status = nodeMap.AStarSearch(*snapshot, queries[index].start, queries[index].goal, results[index].path);
+                    });
+            };
+
+            runQueries(); // Warms up every worker's context
+            SearchStats before = SearchContext::GetMergedStats();
+            Clock::time_point start = Clock::now();
+            runQueries();
+            double elapsedMs = MillisecondsSince(start);
+            SearchStats after = SearchContext::GetMergedStats();
+
+            double rate = queryCount / (elapsedMs / 1000.0);
+            singleThreadRate = threads == 1 ? rate : singleThreadRate;
+            std::cout << "[BENCHMARK] " << threads << " threads: " << rate << " queries/s, speedup " << rate / singleThreadRate
+                << "x, efficiency " << rate / (singleThreadRate * threads) * 100.0 << "%, "
+                << (after.expansions - before.expansions) / queryCount << " expansions per query\n";
+            if (threads == maxThreads) break;
+        }
+
+        SearchStats stats = SearchContext::GetMergedStats();
+        std::cout << "[BENCHMARK] Merged search stats: " << stats.searches << " searches, " << stats.expansions << " expansions, "
+            << (stats.reservedBytes >> 10) << " KB scratch reserved\n";
+        return 0;
+    }
+
+    // Agents patrolling between a few hotspots, so most queries repeat, some in reverse. The
+    // workload runs without the path cache and then with it; halfway through the cached run a
+    // wall is toggled, which must invalidate every entry
+    int PathCacheBenchmark() {
+        const int mapSize = 1024;
+        const int hotspotCount = 12;
+        const int queryCount = 20000;
+        const size_t cacheCapacity = size_t(4) << 20;
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        std::mt19937 rng(11235);
+        std::vector<NodeHandle> hotspots;
+        for (int i = 0; i < hotspotCount; i++) {
+            hotspots.push_back(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+        }
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = hotspots[rng() % hotspotCount];
+            query.goal = hotspots[rng() % hotspotCount];
+        }
+
+        std::cout << "[BENCHMARK] path-cache: " << queryCount << " queries between " << hotspotCount << " hotspots on "
+            << mapSize << "x" << mapSize << " cells, " << (cacheCapacity >> 20) << " MB cache\n";
+
+        std::vector<NodeHandle> path;
+        std::vector<size_t> uncachedLengths;
+        Clock::time_point start = Clock::now();
+        for (const PathQuery& query : queries) {
+            nodeMap.AStarSearch(query.start, query.goal, path);
+            uncachedLengths.push_back(path.size());
+        }
+        double uncachedMs = MillisecondsSince(start);
+
+        nodeMap.SetPathCacheCapacity(cacheCapacity);
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (int i = 0; i < queryCount; i++) {
+            if (i == queryCount / 2) {
+                // Toggle a cell twice: the map ends up as before, but under a new version
+                glm::ivec2 cell = nodeMap.GetNodeCoords(hotspots[0]) + glm::ivec2(1, 0);
+                bool walkable = nodeMap.IsWalkable(cell.x, cell.y);
+                nodeMap.ApplyEdits({ { cell.x, cell.y, !walkable } });
+                nodeMap.ApplyEdits({ { cell.x, cell.y, walkable } });
+            }
+            nodeMap.AStarSearch(queries[i].start, queries[i].goal, path);
+            mismatches += path.size() == uncachedLengths[i] ? 0 : 1;
+        }
+        double cachedMs = MillisecondsSince(start);
+
+        PathCacheStats stats = nodeMap.GetPathCacheStats();
+        std::cout << "[BENCHMARK] Uncached: " << uncachedMs << " ms, cached: " << cachedMs << " ms, speedup " << uncachedMs / cachedMs << "x\n";
+        stats.Print(std::cout);
+        bool pass = mismatches == 0 && stats.invalidations > 0 && stats.bytes <= cacheCapacity;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths differ in length, "
+            << stats.invalidations << " entries invalidated by the edit\n";
+        return pass ? 0 : 1;
+    }
+
+    // Wanderers on a 512x512 map walk a random part of their route and then ask again: half the
+    // time for the same destination (as after being pushed off course), otherwise for a new one
+    // among a set of points of interest. The same query sequence runs without and with the
+    // subpath cache; every path must be as short either way
+    int SubpathCacheBenchmark() {
+        const int mapSize = 512;
+        const int destinationCount = 64;
+        const int agentCount = 32;
+        const int queryCount = 8000;
+        const size_t cacheCapacity = size_t(4) << 20;
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        std::mt19937 rng(8128);
+        std::vector<NodeHandle> destinations;
+        for (int i = 0; i < destinationCount; i++) {
+            destinations.push_back(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+        }
+
+        // Queries depend on the paths found, so the sequence is generated by the uncached run
+        std::vector<PathQuery> queries;
+        std::vector<size_t> uncachedLengths;
+        std::vector<NodeHandle> path;
+        std::vector<PathQuery> agents(agentCount);
+        for (PathQuery& agent : agents) {
+            agent.start = destinations[rng() % destinationCount];
+            agent.goal = destinations[rng() % destinationCount];
+        }
+
+        SearchStats before = SearchContext::GetMergedStats();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < queryCount; i++) {
+            PathQuery& agent = agents[i % agentCount];
+            queries.push_back(agent);
+            nodeMap.AStarSearch(agent.start, agent.goal, path);
+            uncachedLengths.push_back(path.size());
+
+            agent.start = path.empty() ? agent.start : path[rng() % path.size()];
+            agent.goal = rng() % 2 == 0 ? agent.goal : destinations[rng() % destinationCount];
+        }
+        double uncachedMs = MillisecondsSince(start);
+        SearchStats middle = SearchContext::GetMergedStats();
+
+        std::cout << "[BENCHMARK] subpath-cache: " << queryCount << " queries by " << agentCount << " wanderers between "
+            << destinationCount << " destinations on " << mapSize << "x" << mapSize << " cells, " << (cacheCapacity >> 20) << " MB cache\n";
+
+        nodeMap.SetSubpathCacheCapacity(cacheCapacity);
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (int i = 0; i < queryCount; i++) {
+            nodeMap.AStarSearch(queries[i].start, queries[i].goal, path);
+            mismatches += path.size() == uncachedLengths[i] ? 0 : 1;
+        }
+        double cachedMs = MillisecondsSince(start);
+        SearchStats after = SearchContext::GetMergedStats();
+
+        SubpathCacheStats stats = nodeMap.GetSubpathCacheStats();
+        std::cout << "[BENCHMARK] Uncached: " << uncachedMs << " ms, " << (middle.expansions - before.expansions) / queryCount
+            << " expansions per query; cached: " << cachedMs << " ms, " << (after.expansions - middle.expansions) / queryCount
+            << " expansions per query; speedup " << uncachedMs / cachedMs << "x\n";
+        stats.Print(std::cout);
+        bool pass = mismatches == 0 && stats.bytes <= cacheCapacity;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths differ in length\n";
+        return pass ? 0 : 1;
+    }
+
+    // An arena of under 10,000 nodes gets a next-hop table at load. The same random queries run
+    // on a copy of the map without one, and every path must be as short either way
+    int NextHopBenchmark() {
+        const int mapSize = 128;
+        const int queryCount = 20000;
+
+        NodeMap searched;
+        searched.SetNextHopBudget(0);
+        searched.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        NodeMap tabled;
+        Clock::time_point start = Clock::now();
+        tabled.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+        double buildMs = MillisecondsSince(start);
+        if (!tabled.HasNextHops()) {
+            std::cerr << "Error: The arena did not get a next-hop table." << std::endl;
+            return 1;
+        }
+
+        std::mt19937 rng(4181);
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = RandomNodeNear(tabled, rng, 0, 0, 0);
+            query.goal = RandomNodeNear(tabled, rng, 0, 0, 0);
+        }
+
+        std::vector<NodeHandle> path;
+        std::vector<size_t> searchedLengths;
+        start = Clock::now();
+        for (const PathQuery& query : queries) {
+            searched.AStarSearch(query.start, query.goal, path);
+            searchedLengths.push_back(path.size());
+        }
+        double searchedMs = MillisecondsSince(start);
+
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (int i = 0; i < queryCount; i++) {
+            tabled.AStarSearch(queries[i].start, queries[i].goal, path);
+            mismatches += path.size() == searchedLengths[i] ? 0 : 1;
+        }
+        double tabledMs = MillisecondsSince(start);
+
+        // Walking hop by hop must take as many steps as the stored path
+        size_t hopMismatches = 0;
+        for (int i = 0; i < queryCount; i += 97) {
+            size_t nodes = 1;
+            for (NodeHandle node = queries[i].start; node != queries[i].goal && node != InvalidNode; node = tabled.GetNextHop(node, queries[i].goal)) {
+                nodes++;
+            }
+            hopMismatches += nodes == searchedLengths[i] || searchedLengths[i] == 0 ? 0 : 1;
+        }
+
+        std::cout << "[BENCHMARK] next-hop: " << mapSize << "x" << mapSize << " cells, table built in " << buildMs << " ms on "
+            << WorkerPool::Shared().GetWorkerCount() << " workers, " << (tabled.GetMemoryReport().cacheBytes >> 10) << " KB\n";
+        std::cout << "[BENCHMARK] " << queryCount << " queries: A* " << searchedMs << " ms, table " << tabledMs << " ms, speedup "
+            << searchedMs / tabledMs << "x\n";
+        bool pass = mismatches == 0 && hopMismatches == 0;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths and " << hopMismatches
+            << " hop walks differ in length\n";
+        return pass ? 0 : 1;
+    }
+
+    // Mean and 99th percentile of a set of query times, in microseconds
+    void PrintLatency(const char* label, std::vector<double>& microseconds) {
+        std::sort(microseconds.begin(), microseconds.end());
+        double total = 0.0;
+        for (double time : microseconds) total += time;
+        std::cout << "[BENCHMARK] " << label << ": mean " << total / microseconds.size() << " us, p99 "
+            << microseconds[microseconds.size() * 99 / 100] << " us\n";
+    }
+
+    // Builds a compressed path database for a map well past the next-hop table's budget, saves it
+    // and loads it into a second copy of the map, then compares query latency with A*
+    int PathDatabaseBenchmark() {
+        const int mapSize = 224;
+        const int queryCount = 5000;
+
+        auto terrain = [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); };
+        NodeMap built;
+        built.SetNextHopBudget(0);
+        built.Initialise(mapSize, mapSize, 1, terrain, false);
+        Clock::time_point start = Clock::now();
+        built.BuildPathDatabase();
+        double buildMs = MillisecondsSince(start);
+
+        std::string fileName = (std::filesystem::temp_directory_path() / "benchmark.cpd").string();
+        NodeMap loaded;
+        loaded.SetNextHopBudget(0);
+        loaded.Initialise(mapSize, mapSize, 1, terrain, false);
+        start = Clock::now();
+        bool roundTrip = built.SavePathDatabase(fileName) && loaded.LoadPathDatabase(fileName);
+        double saveLoadMs = MillisecondsSince(start);
+        std::filesystem::remove(fileName);
+        if (!roundTrip) return 1;
+
+        NodeMap searched;
+        searched.SetNextHopBudget(0);
+        searched.Initialise(mapSize, mapSize, 1, terrain, false);
+
+        std::mt19937 rng(6765);
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = RandomNodeNear(searched, rng, 0, 0, 0);
+            query.goal = RandomNodeNear(searched, rng, 0, 0, 0);
+        }
+
+        std::vector<NodeHandle> path;
+        std::vector<size_t> searchedLengths;
+        std::vector<double> searchedTimes;
+        for (const PathQuery& query : queries) {
+            Clock::time_point queryStart = Clock::now();
+            searched.AStarSearch(query.start, query.goal, path);
+            searchedTimes.push_back(MillisecondsSince(queryStart) * 1000.0);
+            searchedLengths.push_back(path.size());
+        }
+
+        size_t mismatches = 0;
+        std::vector<double> databaseTimes;
+        for (int i = 0; i < queryCount; i++) {
+            Clock::time_point queryStart = Clock::now();
+            loaded.AStarSearch(queries[i].start, queries[i].goal, path);
+            databaseTimes.push_back(MillisecondsSince(queryStart) * 1000.0);
+            mismatches += path.size() == searchedLengths[i] ? 0 : 1;
+        }
+
+        size_t nodeCount = 0;
+        for (int y = 0; y < mapSize; y++) {
+            for (int x = 0; x < mapSize; x++) nodeCount += loaded.IsWalkable(x, y) ? 1 : 0;
+        }
+        size_t databaseBytes = loaded.GetMemoryReport().cacheBytes;
+        std::cout << "[BENCHMARK] path-database: " << mapSize << "x" << mapSize << " cells, " << nodeCount << " nodes, built in "
+            << buildMs << " ms on " << WorkerPool::Shared().GetWorkerCount() << " workers, saved and loaded in " << saveLoadMs << " ms\n";
+        std::cout << "[BENCHMARK] " << (databaseBytes >> 10) << " KB, against " << (nodeCount * nodeCount / 4 >> 10)
+            << " KB for the uncompressed next-hop table\n";
+        PrintLatency("A*", searchedTimes);
+        PrintLatency("Path database", databaseTimes);
+        bool pass = mismatches == 0;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths differ in length\n";
+        return pass ? 0 : 1;
+    }
+
+    // Random starts, with most goals drawn from a few popular destinations and the rest anywhere.
+    // The budget holds fewer fields than there are popular goals, so the cache has to pick. The
+    // same queries run without and with goal fields; every path must be as short either way
+    int GoalFieldBenchmark() {
+        const int mapSize = 512;
+        const int popularCount = 12;
+        const int queryCount = 20000;
+        const size_t budget = size_t(8) << 20;
+
+        NodeMap nodeMap;
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        std::mt19937 rng(2584);
+        std::vector<NodeHandle> popular;
+        for (int i = 0; i < popularCount; i++) {
+            popular.push_back(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+        }
+        // Skewed: destination i is picked about twice as often as destination i + 1
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            int pick = 0;
+            while (pick < popularCount && rng() % 2 == 0) pick++;
+            query.goal = rng() % 5 == 0 || pick == popularCount ? RandomNodeNear(nodeMap, rng, 0, 0, 0) : popular[pick];
+        }
+
+        std::vector<NodeHandle> path;
+        std::vector<size_t> searchedLengths;
+        Clock::time_point start = Clock::now();
+        for (const PathQuery& query : queries) {
+            nodeMap.AStarSearch(query.start, query.goal, path);
+            searchedLengths.push_back(path.size());
+        }
+        double searchedMs = MillisecondsSince(start);
+
+        nodeMap.SetGoalFieldBudget(budget);
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (int i = 0; i < queryCount; i++) {
+            nodeMap.AStarSearch(queries[i].start, queries[i].goal, path);
+            mismatches += path.size() == searchedLengths[i] ? 0 : 1;
+        }
+        double fieldMs = MillisecondsSince(start);
+
+        GoalFieldStats stats = nodeMap.GetGoalFieldStats();
+        std::cout << "[BENCHMARK] goal-fields: " << queryCount << " queries, 80% to " << popularCount << " popular goals, on "
+            << mapSize << "x" << mapSize << " cells, " << (budget >> 20) << " MB budget\n";
+        std::cout << "[BENCHMARK] Searched: " << searchedMs << " ms, with goal fields: " << fieldMs << " ms, speedup "
+            << searchedMs / fieldMs << "x\n";
+        stats.Print(std::cout);
+        for (const HotGoal& hot : nodeMap.GetHotGoals(5)) {
+            glm::ivec2 coords = nodeMap.GetNodeCoords(hot.goal);
+            std::cout << "[BENCHMARK] Hot goal (" << coords.x << ", " << coords.y << "): " << hot.queries << " recent queries"
+                << (hot.hasField ? ", has a field" : "") << "\n";
+        }
+        bool pass = mismatches == 0 && stats.bytes <= budget;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths differ in length\n";
+        return pass ? 0 : 1;
+    }
+
+    // Cold and warm start of maps with precomputed structures. The first load of each map
+    // builds its structures and saves them in a fresh precompute directory; loading the same map
+    // again maps them from there. Both must answer every query identically
+    int PrecomputeCacheBenchmark() {
+        const int tableMapSize = 128;
+        const int databaseMapSize = 224;
+        const int queryCount = 2000;
+
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "pathfinding-precompute-benchmark";
+        std::filesystem::remove_all(directory);
+        auto tableTerrain = [tableMapSize](int x, int y) { return LargeMapTerrain(x, y, tableMapSize); };
+        auto databaseTerrain = [databaseMapSize](int x, int y) { return LargeMapTerrain(x, y, databaseMapSize); };
+
+        // Cold: nothing saved yet
+        NodeMap coldTable;
+        coldTable.SetPrecomputeDirectory(directory.string());
+        Clock::time_point start = Clock::now();
+        coldTable.Initialise(tableMapSize, tableMapSize, 1, tableTerrain, false);
+        double coldTableMs = MillisecondsSince(start);
+
+        NodeMap coldDatabase;
+        coldDatabase.SetNextHopBudget(0);
+        coldDatabase.SetPrecomputeDirectory(directory.string());
+        start = Clock::now();
+        coldDatabase.Initialise(databaseMapSize, databaseMapSize, 1, databaseTerrain, false);
+        coldDatabase.BuildPathDatabase();
+        double coldDatabaseMs = MillisecondsSince(start);
+
+        // Warm: same maps, new NodeMaps
+        NodeMap warmTable;
+        warmTable.SetPrecomputeDirectory(directory.string());
+        start = Clock::now();
+        warmTable.Initialise(tableMapSize, tableMapSize, 1, tableTerrain, false);
+        double warmTableMs = MillisecondsSince(start);
+
+        NodeMap warmDatabase;
+        warmDatabase.SetNextHopBudget(0);
+        warmDatabase.SetPrecomputeDirectory(directory.string());
+        start = Clock::now();
+        warmDatabase.Initialise(databaseMapSize, databaseMapSize, 1, databaseTerrain, false);
+        double warmDatabaseMs = MillisecondsSince(start);
+
+        std::mt19937 rng(10946);
+        size_t mismatches = 0;
+        std::vector<NodeHandle> coldPath;
+        std::vector<NodeHandle> warmPath;
+        for (int i = 0; i < queryCount; i++) {
+            NodeMap& cold = i % 2 == 0 ? coldTable : coldDatabase;
+            NodeMap& warm = i % 2 == 0 ? warmTable : warmDatabase;
+            NodeHandle from = RandomNodeNear(cold, rng, 0, 0, 0);
+            NodeHandle to = RandomNodeNear(cold, rng, 0, 0, 0);
+            cold.AStarSearch(from, to, coldPath);
+            warm.AStarSearch(from, to, warmPath);
+            mismatches += coldPath == warmPath ? 0 : 1;
+        }
+        size_t files = std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator());
+        std::filesystem::remove_all(directory);
+
+        std::cout << "[BENCHMARK] precompute-cache: next-hop table for " << tableMapSize << "x" << tableMapSize << " cells, path database for "
+            << databaseMapSize << "x" << databaseMapSize << " cells, " << files << " files saved\n";
+        std::cout << "[BENCHMARK] Next-hop map: cold start " << coldTableMs << " ms, warm start " << warmTableMs << " ms, speedup "
+            << coldTableMs / warmTableMs << "x\n";
+        std::cout << "[BENCHMARK] Path database map: cold start " << coldDatabaseMs << " ms, warm start " << warmDatabaseMs << " ms, speedup "
+            << coldDatabaseMs / warmDatabaseMs << "x\n";
+        bool pass = mismatches == 0 && warmTable.HasNextHops() && warmDatabase.HasNextHops() && files == 2;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << mismatches << " paths differ between cold and warm maps\n";
+        return pass ? 0 : 1;
+    }
+
+    // Destruction on a 2048x2048 map: every frame, cells around a random blast point are toggled
+    // with SetWalkable() and the frame's edits published together. Each edit is timed against a
+    // full rebuild of the map. The edited graph must then match a map built from scratch with
+    // the final walkability, and after random edge costs (some below 1) every A* path must
+    // cost exactly as much as the shortest one found by Dijkstra. A small arena with a next-hop
+    // table is edited the same way: publishing must not wait for the table, which catches up in
+    // the background and must then give paths as short as A* on the final map
+    int RuntimeEditBenchmark() {
+        const int mapSize = 2048;
+        const int frameCount = 200;
+        const int editsPerFrame = 64;
+        const int blastRadius = 6;
+        const int costEdits = 4000;
+        const int costQueries = 12;
+
+        std::vector<char> walkable(static_cast<size_t>(mapSize) * mapSize);
+        for (int y = 0; y < mapSize; y++) {
+            for (int x = 0; x < mapSize; x++) {
+                walkable[static_cast<size_t>(y) * mapSize + x] = LargeMapTerrain(x, y, mapSize);
+            }
+        }
+        auto terrain = [&walkable, mapSize](int x, int y) { return walkable[static_cast<size_t>(y) * mapSize + x] != 0; };
+
+        NodeMap nodeMap;
+        Clock::time_point start = Clock::now();
+        nodeMap.Initialise(mapSize, mapSize, 1, terrain, false);
+        double rebuildMs = MillisecondsSince(start);
+
+        std::mt19937 rng(6765);
+        std::vector<double> editUs;
+        std::vector<double> publishUs;
+        for (int frame = 0; frame < frameCount; frame++) {
+            glm::ivec2 blast = nodeMap.GetNodeCoords(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+            for (int i = 0; i < editsPerFrame; i++) {
+                int x = std::clamp(blast.x + static_cast<int>(rng() % (2 * blastRadius + 1)) - blastRadius, 0, mapSize - 1);
+                int y = std::clamp(blast.y + static_cast<int>(rng() % (2 * blastRadius + 1)) - blastRadius, 0, mapSize - 1);
+                char& cell = walkable[static_cast<size_t>(y) * mapSize + x];
+                cell = !cell;
+                start = Clock::now();
+                nodeMap.SetWalkable(x, y, cell != 0);
+                editUs.push_back(MillisecondsSince(start) * 1000.0);
+            }
+            start = Clock::now();
+            nodeMap.PublishEdits();
+            publishUs.push_back(MillisecondsSince(start) * 1000.0);
+        }
+
+        NodeMap rebuilt;
+        rebuilt.Initialise(mapSize, mapSize, 1, terrain, false);
+        bool sameGraph = nodeMap.GetContentHash() == rebuilt.GetContentHash();
+
+        std::vector<double> costUs;
+        for (int i = 0; i < costEdits; i++) {
+            glm::ivec2 from = nodeMap.GetNodeCoords(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+            glm::ivec2 to = from + (rng() % 2 == 0 ? glm::ivec2(1, 0) : glm::ivec2(0, 1));
+            if (!nodeMap.IsWalkable(to.x, to.y)) continue;
+            const float costs[] = { 0.5f, 2.0f, 4.0f };
+            start = Clock::now();
+            nodeMap.SetEdgeCost(from.x, from.y, to.x, to.y, costs[rng() % 3]);
+            costUs.push_back(MillisecondsSince(start) * 1000.0);
+        }
+        nodeMap.PublishEdits();
+
+        std::shared_ptr<const MapSnapshot> snapshot = nodeMap.GetSnapshot();
+        std::vector<NodeHandle> path;
+        size_t mismatches = 0;
+        for (int i = 0; i < costQueries; i++) {
+            NodeHandle from = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            NodeHandle to = RandomNodeNear(nodeMap, rng, 0, 0, 0);
+            std::shared_ptr<const GoalDistanceField> field = GoalDistanceField::Build(*snapshot, to);
+            float pathCost = 0.0f;
+            if (nodeMap.AStarSearch(*snapshot, from, to, path) == SearchStatus::Found) {
+                for (size_t step = 1; step < path.size(); step++) {
+                    for (const Edge& connection : snapshot->GetNodeData(path[step - 1]).connections) {
+                        if (connection.target == path[step]) pathCost += connection.cost;
+                    }
+                }
+            }
+            else {
+                pathCost = FLT_MAX;
+            }
+            float shortest = field->GetDistance(from);
+            mismatches += std::abs(pathCost - shortest) <= 1e-3f * std::max(1.0f, shortest) ? 0 : 1;
+        }
+
+        const int arenaSize = 96;
+        const int arenaFrames = 50;
+        const int arenaEditsPerFrame = 8;
+        const int arenaQueries = 2000;
+
+        std::vector<char> arenaWalkable(static_cast<size_t>(arenaSize) * arenaSize);
+        for (int y = 0; y < arenaSize; y++) {
+            for (int x = 0; x < arenaSize; x++) {
+                arenaWalkable[static_cast<size_t>(y) * arenaSize + x] = LargeMapTerrain(x, y, arenaSize);
+            }
+        }
+        auto arenaTerrain = [&arenaWalkable, arenaSize](int x, int y) { return arenaWalkable[static_cast<size_t>(y) * arenaSize + x] != 0; };
+
+        NodeMap arena;
+        start = Clock::now();
+        arena.Initialise(arenaSize, arenaSize, 1, arenaTerrain, false);
+        double tableBuildMs = MillisecondsSince(start);
+        if (!arena.HasNextHops()) {
+            std::cerr << "Error: The arena did not get a next-hop table." << std::endl;
+            return 1;
+        }
+
+        std::vector<double> arenaPublishUs;
+        for (int frame = 0; frame < arenaFrames; frame++) {
+            for (int i = 0; i < arenaEditsPerFrame; i++) {
+                int x = static_cast<int>(rng() % arenaSize);
+                int y = static_cast<int>(rng() % arenaSize);
+                char& cell = arenaWalkable[static_cast<size_t>(y) * arenaSize + x];
+                cell = !cell;
+                arena.SetWalkable(x, y, cell != 0);
+            }
+            start = Clock::now();
+            arena.PublishEdits();
+            arenaPublishUs.push_back(MillisecondsSince(start) * 1000.0);
+        }
+        start = Clock::now();
+        arena.WaitForBackgroundWork();
+        double catchUpMs = MillisecondsSince(start);
+
+        NodeMap arenaSearched;
+        arenaSearched.SetNextHopBudget(0);
+        arenaSearched.Initialise(arenaSize, arenaSize, 1, arenaTerrain, false);
+        size_t arenaMismatches = 0;
+        std::vector<NodeHandle> searchedPath;
+        for (int i = 0; i < arenaQueries; i++) {
+            NodeHandle from = RandomNodeNear(arena, rng, 0, 0, 0);
+            NodeHandle to = RandomNodeNear(arena, rng, 0, 0, 0);
+            arena.AStarSearch(from, to, path);
+            arenaSearched.AStarSearch(from, to, searchedPath);
+            arenaMismatches += path.size() == searchedPath.size() ? 0 : 1;
+        }
+        bool caughtUp = arena.HasNextHops();
+
+        std::cout << "[BENCHMARK] runtime-edits: " << frameCount << " frames of " << editsPerFrame << " walkability edits on "
+            << mapSize << "x" << mapSize << " cells, then " << costUs.size() << " edge cost edits\n";
+        std::cout << "[BENCHMARK] Full rebuild: " << rebuildMs << " ms\n";
+        PrintLatency("SetWalkable", editUs);
+        PrintLatency("PublishEdits (per frame)", publishUs);
+        PrintLatency("SetEdgeCost", costUs);
+        std::cout << "[BENCHMARK] Arena with a next-hop table: " << arenaFrames << " frames of " << arenaEditsPerFrame << " edits on "
+            << arenaSize << "x" << arenaSize << " cells, load with table " << tableBuildMs << " ms\n";
+        PrintLatency("PublishEdits with a table (per frame)", arenaPublishUs);
+        std::cout << "[BENCHMARK] Table caught up " << catchUpMs << " ms after the last publish\n";
+        bool pass = sameGraph && mismatches == 0 && caughtUp && arenaMismatches == 0;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": edited graph " << (sameGraph ? "matches" : "differs from")
+            << " a rebuilt one, " << mismatches << " of " << costQueries << " weighted paths are not shortest, table "
+            << (caughtUp ? "caught up" : "did not catch up") << " and " << arenaMismatches << " of " << arenaQueries
+            << " arena paths differ in length\n";
+        return pass ? 0 : 1;
+    }
+
+    // Runs the same queries until every buffer has grown, then counts heap allocations during one
+    // more round: first with the caches off, then with the path and subpath caches on at the
+    // demo's sizes, which the queries overflow so entries keep being evicted and replaced.
+    // Warmed-up searches must not allocate either way. Needs a build with
+    // AIFORGAMES_COUNT_ALLOCATIONS defined, which swaps in the counting operator new
+    int AllocationBenchmark() {
+        if (!IsCountingAllocations()) {
+            std::cerr << "Error: The alloc benchmark needs a build with AIFORGAMES_COUNT_ALLOCATIONS defined" << std::endl;
+            return 2;
+        }
+        const int mapSize = 512;
+        const int hotspotCount = 48;
+        const int queryCount = 4000;
+        const int warmupRounds = 6;
+
+        NodeMap nodeMap;
+        nodeMap.SetNextHopBudget(0);
+        nodeMap.Initialise(mapSize, mapSize, 1, [mapSize](int x, int y) { return LargeMapTerrain(x, y, mapSize); }, false);
+
+        // Trips between hotspots repeat, so the caches get hits, slices and seeded searches
+        std::mt19937 rng(31415);
+        std::vector<NodeHandle> hotspots;
+        for (int i = 0; i < hotspotCount; i++) {
+            hotspots.push_back(RandomNodeNear(nodeMap, rng, 0, 0, 0));
+        }
+        std::vector<PathQuery> queries(queryCount);
+        for (PathQuery& query : queries) {
+            query.start = rng() % 4 == 0 ? RandomNodeNear(nodeMap, rng, 0, 0, 0) : hotspots[rng() % hotspotCount];
+            query.goal = hotspots[rng() % hotspotCount];
+        }
+
+        std::vector<NodeHandle> path;
+        auto runRound = [&]() {
+            for (const PathQuery& query : queries) {
+                nodeMap.AStarSearch(query.start, query.goal, path);
+            }
+            };
+        auto countAllocations = [&]() {
+            for (int round = 0; round < warmupRounds; round++) {
+                runRound();
+            }
+            size_t before = GetAllocationCount();
+            runRound();
+            return GetAllocationCount() - before;
+            };
+
+        std::cout << "[BENCHMARK] alloc: " << queryCount << " queries on " << mapSize << "x" << mapSize << " cells, "
+            << warmupRounds << " warm-up rounds before each measured one\n";
+        size_t uncached = countAllocations();
+        std::cout << "[BENCHMARK] Caches off: " << uncached << " allocations\n";
+
+        nodeMap.SetPathCacheCapacity(256 * 1024);
+        nodeMap.SetSubpathCacheCapacity(512 * 1024);
+        for (int round = 0; round < warmupRounds; round++) {
+            runRound();
+        }
+        PathCacheStats pathBefore = nodeMap.GetPathCacheStats();
+        SubpathCacheStats subpathBefore = nodeMap.GetSubpathCacheStats();
+        size_t cached = countAllocations();
+        PathCacheStats pathAfter = nodeMap.GetPathCacheStats();
+        SubpathCacheStats subpathAfter = nodeMap.GetSubpathCacheStats();
+        size_t evictions = pathAfter.evictions - pathBefore.evictions + subpathAfter.evictions - subpathBefore.evictions;
+        std::cout << "[BENCHMARK] Caches on: " << cached << " allocations, " << evictions << " evictions in the measured rounds\n";
+        pathAfter.Print(std::cout);
+        subpathAfter.Print(std::cout);
+
+        bool pass = uncached == 0 && cached == 0;
+        std::cout << "[BENCHMARK] " << (pass ? "PASS" : "FAIL") << ": " << uncached + cached << " allocations in warmed-up searches\n";
+        return pass ? 0 : 1;
+    }
+}
+
+namespace AIForGames {
+    int RunBenchmark(const std::string& name)
+    {
+        if (name == "large-map") return LargeMapBenchmark();
+        if (name == "batch") return BatchBenchmark();
+        if (name == "load") return LoadBenchmark();
+        if (name == "parallel-search") return ParallelSearchBenchmark();
+        if (name == "scaling") return ScalingBenchmark();
+        if (name == "path-cache") return PathCacheBenchmark();
+        if (name == "subpath-cache") return SubpathCacheBenchmark();
+        if (name == "next-hop") return NextHopBenchmark();
+        if (name == "path-database") return PathDatabaseBenchmark();
+        if (name == "goal-fields") return GoalFieldBenchmark();
+        if (name == "precompute-cache") return PrecomputeCacheBenchmark();
+        if (name == "runtime-edits") return RuntimeEditBenchmark();
+        if (name == "alloc") return AllocationBenchmark();
+
+        std::cerr << "Error: Unknown benchmark '" << name << "'. Available: large-map, batch, load, parallel-search, scaling, path-cache, subpath-cache, next-hop, path-database, goal-fields, precompute-cache, runtime-edits, alloc" << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+namespace AIForGames {
+
+    // Headless benchmarks, run from the command line with:
+    //     AIE_Starter.exe --benchmark <name>
+    // Each benchmark prints its results to the console and returns a process exit code
+    // (0 on success, non-zero if a stated budget was exceeded or the name is unknown).
+    int RunBenchmark(const std::string& name);
+}
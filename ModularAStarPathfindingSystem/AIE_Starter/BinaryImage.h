@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace AIForGames {
+
+    // A binary image is a header followed by arrays, each starting on an 8-byte boundary, in one
+    // block of memory. Precomputed search structures keep their data in an image and read it
+    // through spans, so the same bytes work whether they were just built in memory or mapped
+    // from a file saved earlier (see MappedFile), with nothing to parse or copy on load.
+    // Values are stored in the machine's byte order.
+
+    // Builds an image in memory
+    class BinaryImageWriter
+    {
+    public:
+        template <typename T>
+        void Append(const T& value) { AppendBytes(&value, sizeof(T)); } // Appends a header or a single value
+
+        template <typename T>
+        void AppendArray(std::span<const T> values) { AppendBytes(values.data(), values.size_bytes()); } // Appends an array
+
+        std::shared_ptr<const std::vector<std::uint64_t>> Finish() { return std::make_shared<const std::vector<std::uint64_t>>(std::move(m_words)); } // Hands over the image
+
+    private:
+        void AppendBytes(const void* data, size_t bytes) {
+            size_t offset = m_words.size() * sizeof(std::uint64_t);
+            m_words.resize(m_words.size() + (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+            if (bytes > 0) std::memcpy(reinterpret_cast<std::uint8_t*>(m_words.data()) + offset, data, bytes);
+        }
+
+        std::vector<std::uint64_t> m_words; // Whole words keep every array 8-byte aligned
+    };
+
+    // Reads an image back in the order it was written. Every read checks that it stays inside
+    // the image, so a truncated or damaged file fails instead of reading past its end
+    class BinaryImageReader
+    {
+    public:
+        BinaryImageReader(const std::uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        template <typename T>
+        bool Read(T& value) { // Copies out a header or a single value
+            const std::uint8_t* bytes = Take(sizeof(T));
+            if (bytes) std::memcpy(&value, bytes, sizeof(T));
+            return bytes != nullptr;
+        }
+
+        template <typename T>
+        bool ReadArray(std::span<const T>& values, std::uint64_t count) { // Points values at an array inside the image
+            if (count > m_size / sizeof(T)) return false;
+            const std::uint8_t* bytes = Take(static_cast<size_t>(count) * sizeof(T));
+            if (bytes) values = std::span<const T>(reinterpret_cast<const T*>(bytes), static_cast<size_t>(count));
+            return bytes != nullptr;
+        }
+
+        bool AtEnd() const { return m_offset == m_size; } // True once everything has been read
+
+    private:
+        const std::uint8_t* Take(size_t bytes) {
+            size_t padded = (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t) * sizeof(std::uint64_t);
+            if (padded > m_size - m_offset) return nullptr;
+            const std::uint8_t* start = m_data + m_offset;
+            m_offset += padded;
+            return start;
+        }
+
+        const std::uint8_t* m_data;
+        size_t m_size;
+        size_t m_offset{ 0 };
+    };
+
+    // Writes an image to a file with a different header in front, for fields that only matter
+    // on disk such as the map hash. The header's size must be a multiple of 8
+    template <typename Header>
+    bool SaveBinaryImage(const std::string& fileName, const std::uint8_t* image, size_t size, const Header& header) {
+        static_assert(sizeof(Header) % sizeof(std::uint64_t) == 0, "Image headers must keep the arrays after them aligned");
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char*>(image) + sizeof(Header), static_cast<std::streamsize>(size - sizeof(Header)));
+        return static_cast<bool>(file.flush());
+    }
+}
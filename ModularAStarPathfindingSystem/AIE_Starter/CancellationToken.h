@@ -0,0 +1,23 @@
+#pragma once
+#include <atomic>
+#include <memory>
+
+namespace AIForGames {
+
+    // CancellationToken lets one thread ask work running on another to stop early. Copies share
+    // one flag: the requester keeps a copy and calls Cancel(), and the search polls IsCancelled()
+    // at safe points and gives up. A default-constructed token can never be cancelled and costs
+    // nothing to check, so code that does not need cancellation simply passes {}.
+    class CancellationToken
+    {
+        std::shared_ptr<std::atomic<bool>> m_cancelled; // Shared flag; null for tokens that cannot be cancelled
+
+    public:
+        CancellationToken() = default; // Token that is never cancelled
+        static CancellationToken Create() { CancellationToken token; token.m_cancelled = std::make_shared<std::atomic<bool>>(false); return token; } // New cancellable token
+
+        void Cancel() const { if (m_cancelled) m_cancelled->store(true, std::memory_order_relaxed); } // Asks every holder of this token to stop
+        bool CanBeCancelled() const { return m_cancelled != nullptr; } // False for default-constructed tokens
+        bool IsCancelled() const { return m_cancelled && m_cancelled->load(std::memory_order_relaxed); } // True once Cancel() has been called on any copy
+    };
+}
@@ -0,0 +1,257 @@
+#include "CompressedPathDatabase.h"
+#include "MapSnapshot.h"
+#include "WorkerPool.h"
+#include "MappedFile.h"
+#include "BinaryImage.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+using namespace AIForGames;
+
+namespace {
+    // A connection between depth-first numbers
+    struct DenseEdge {
+        std::uint32_t target;
+        float cost;
+    };
+
+    // Per-worker scratch of the row searches
+    struct RowScratch {
+        std::vector<float> distance;
+        std::vector<std::uint8_t> firstMove; // Connection slot of the source that starts each node's shortest path
+        std::vector<std::uint32_t> queue; // FIFO for maps with a single edge cost
+        std::vector<std::pair<float, std::uint32_t>> heap; // Dijkstra open list otherwise
+    };
+}
+
+std::shared_ptr<const CompressedPathDatabase> CompressedPathDatabase::Build(const MapSnapshot& snapshot, WorkerPool& pool) {
+    const GridLayout& layout = snapshot.GetLayout();
+
+    // Number the nodes depth-first, one connected component after another
+    std::vector<NodeHandle> nodes;
+    std::vector<std::uint32_t> components;
+    std::vector<bool> visited(layout.HandleCount());
+    std::vector<NodeHandle> stack;
+    for (int y = 0; y < layout.height; y++) {
+        for (int x = 0; x < layout.width; x++) {
+            NodeHandle root = snapshot.GetNode(x, y);
+            if (root == InvalidNode || visited[root]) continue;
+
+            std::uint32_t component = static_cast<std::uint32_t>(nodes.size());
+            stack.push_back(root);
+            while (!stack.empty()) {
+                NodeHandle current = stack.back();
+                stack.pop_back();
+                if (visited[current]) continue;
+                visited[current] = true;
+                nodes.push_back(current);
+                components.push_back(component);
+
+                const EdgeList& connections = snapshot.GetNodeData(current).connections;
+                for (size_t slot = connections.size(); slot-- > 0;) {
+                    if (!visited[connections[slot].target]) stack.push_back(connections[slot].target);
+                }
+            }
+        }
+    }
+    std::vector<std::uint32_t> orderOf(layout.HandleCount(), NoIndex);
+    for (std::uint32_t order = 0; order < nodes.size(); order++) {
+        orderOf[nodes[order]] = order;
+    }
+
+    // Adjacency in depth-first numbers, only needed while building
+    const size_t nodeCount = nodes.size();
+    std::vector<DenseEdge> edges(nodeCount * EdgeList::Capacity);
+    std::vector<std::uint8_t> edgeCounts(nodeCount);
+    bool uniformCost = true;
+    float firstCost = -1.0f;
+    for (std::uint32_t order = 0; order < nodeCount; order++) {
+        for (const Edge& connection : snapshot.GetNodeData(nodes[order]).connections) {
+            edges[order * EdgeList::Capacity + edgeCounts[order]++] = { orderOf[connection.target], connection.cost };
+            firstCost = firstCost < 0.0f ? connection.cost : firstCost;
+            uniformCost = uniformCost && connection.cost == firstCost;
+        }
+    }
+
+    // One shortest path tree per source. Each node inherits its parent's first move, except
+    // the source's neighbours, whose first move is the connection itself
+    std::vector<std::vector<std::uint32_t>> rows(nodeCount);
+    std::vector<RowScratch> scratch(pool.GetWorkerCount());
+    pool.ParallelFor(nodeCount, [&](size_t source, unsigned int worker) {
+        RowScratch& rowScratch = scratch[worker];
+        std::vector<float>& distance = rowScratch.distance;
+        std::vector<std::uint8_t>& firstMove = rowScratch.firstMove;
+        distance.assign(nodeCount, FLT_MAX);
+        firstMove.resize(nodeCount);
+        auto reach = [&](std::uint32_t from, std::uint8_t slot, std::uint32_t node) {
+            firstMove[node] = from == source ? slot : firstMove[from];
+            };
+
+        distance[source] = 0.0f;
+        if (uniformCost) {
+            std::vector<std::uint32_t>& queue = rowScratch.queue;
+            queue.clear();
+            queue.push_back(static_cast<std::uint32_t>(source));
+            for (size_t next = 0; next < queue.size(); next++) {
+                std::uint32_t current = queue[next];
+                for (std::uint8_t slot = 0; slot < edgeCounts[current]; slot++) {
+                    const DenseEdge& edge = edges[current * EdgeList::Capacity + slot];
+                    if (distance[edge.target] != FLT_MAX) continue;
+                    distance[edge.target] = distance[current] + edge.cost;
+                    reach(current, slot, edge.target);
+                    queue.push_back(edge.target);
+                }
+            }
+        }
+        else {
+            std::vector<std::pair<float, std::uint32_t>>& heap = rowScratch.heap;
+            heap.clear();
+            heap.emplace_back(0.0f, static_cast<std::uint32_t>(source));
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                auto [currentDistance, current] = heap.back();
+                heap.pop_back();
+                if (currentDistance > distance[current]) continue; // Stale entry
+                for (std::uint8_t slot = 0; slot < edgeCounts[current]; slot++) {
+                    const DenseEdge& edge = edges[current * EdgeList::Capacity + slot];
+                    float tentative = currentDistance + edge.cost;
+                    if (tentative >= distance[edge.target]) continue;
+                    distance[edge.target] = tentative;
+                    reach(current, slot, edge.target);
+                    heap.emplace_back(tentative, edge.target);
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                }
+            }
+        }
+
+        // Run-length encode the row. Unreachable targets and the source itself take any move,
+        // so they extend the current run; the first run starts at 0 for the binary search
+        std::vector<std::uint32_t>& row = rows[source];
+        int currentMove = -1;
+        for (std::uint32_t target = 0; target < nodeCount; target++) {
+            if (target == source || distance[target] == FLT_MAX || firstMove[target] == currentMove) continue;
+            currentMove = firstMove[target];
+            row.push_back(((row.empty() ? 0 : target) << MoveBits) | static_cast<std::uint32_t>(currentMove));
+        }
+        row.shrink_to_fit();
+        });
+
+    std::vector<std::uint64_t> rowStarts;
+    rowStarts.reserve(nodeCount + 1);
+    size_t runCount = 0;
+    for (const std::vector<std::uint32_t>& row : rows) {
+        rowStarts.push_back(runCount);
+        runCount += row.size();
+    }
+    rowStarts.push_back(runCount);
+
+    BinaryImageWriter writer;
+    Header header{ { 'C', 'P', 'D', '2' }, ImageFormat, 0, layout.width, layout.height, nodeCount, orderOf.size(), runCount };
+    writer.Append(header);
+    writer.AppendArray(std::span<const NodeHandle>(nodes));
+    writer.AppendArray(std::span<const std::uint32_t>(orderOf));
+    writer.AppendArray(std::span<const std::uint32_t>(components));
+    writer.AppendArray(std::span<const std::uint64_t>(rowStarts));
+    std::vector<std::uint32_t> runs;
+    for (std::vector<std::uint32_t>& row : rows) {
+        runs.insert(runs.end(), row.begin(), row.end());
+        row = std::vector<std::uint32_t>();
+    }
+    writer.AppendArray(std::span<const std::uint32_t>(runs));
+    std::shared_ptr<const std::vector<std::uint64_t>> image = writer.Finish();
+
+    std::shared_ptr<CompressedPathDatabase> database(new CompressedPathDatabase());
+    database->m_version = snapshot.GetVersion();
+    database->Attach(image, reinterpret_cast<const std::uint8_t*>(image->data()), image->size() * sizeof(std::uint64_t), header);
+    return database;
+}
+
+bool CompressedPathDatabase::Attach(std::shared_ptr<const void> storage, const std::uint8_t* image, size_t size, Header& header) {
+    BinaryImageReader reader(image, size);
+    if (!reader.Read(header) || std::memcmp(header.magic, "CPD2", sizeof(header.magic)) != 0 || header.format != ImageFormat
+        || !reader.ReadArray(m_nodes, header.nodeCount) || !reader.ReadArray(m_orderOf, header.handleCount)
+        || !reader.ReadArray(m_component, header.nodeCount) || !reader.ReadArray(m_rowStarts, header.nodeCount + 1)
+        || !reader.ReadArray(m_runs, header.runCount) || m_rowStarts.back() != header.runCount) {
+        return false;
+    }
+    m_storage = std::move(storage);
+    m_image = image;
+    m_imageSize = size;
+    return true;
+}
+
+size_t CompressedPathDatabase::GetMemoryUsage() const {
+    return sizeof(*this) + m_imageSize;
+}
+
+// The last run starting at or before the goal holds its move
+int CompressedPathDatabase::GetMove(std::uint32_t from, std::uint32_t goal) const {
+    const std::uint32_t* begin = m_runs.data() + m_rowStarts[from];
+    const std::uint32_t* end = m_runs.data() + m_rowStarts[from + 1];
+    const std::uint32_t* run = std::upper_bound(begin, end, (goal << MoveBits) | ((1u << MoveBits) - 1)) - 1;
+    return static_cast<int>(*run & ((1u << MoveBits) - 1));
+}
+
+NodeHandle CompressedPathDatabase::GetNextHop(const MapSnapshot& snapshot, NodeHandle from, NodeHandle goal) const {
+    std::uint32_t fromOrder = OrderOf(from);
+    std::uint32_t goalOrder = OrderOf(goal);
+    if (fromOrder == NoIndex || goalOrder == NoIndex || fromOrder == goalOrder || m_component[fromOrder] != m_component[goalOrder]) return InvalidNode;
+    return snapshot.GetNodeData(from).connections[GetMove(fromOrder, goalOrder)].target;
+}
+
+SearchStatus CompressedPathDatabase::ExtractPath(const MapSnapshot& snapshot, NodeHandle start, NodeHandle goal, std::vector<NodeHandle>& outPath) const {
+    outPath.clear();
+    std::uint32_t startOrder = OrderOf(start);
+    std::uint32_t goalOrder = OrderOf(goal);
+    if (startOrder == NoIndex || goalOrder == NoIndex) return SearchStatus::InvalidEndpoints;
+    if (m_component[startOrder] != m_component[goalOrder]) return SearchStatus::NoPath;
+
+    outPath.push_back(start);
+    for (NodeHandle current = start; current != goal;) {
+        current = snapshot.GetNodeData(current).connections[GetMove(OrderOf(current), goalOrder)].target;
+        outPath.push_back(current);
+    }
+    return SearchStatus::Found;
+}
+
+bool CompressedPathDatabase::Save(const std::string& fileName, std::uint64_t mapHash) const {
+    Header header;
+    std::memcpy(&header, m_image, sizeof(header));
+    header.mapHash = mapHash;
+    if (!SaveBinaryImage(fileName, m_image, m_imageSize, header)) {
+        std::cerr << "Error: Failed to write the path database to '" << fileName << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The content hash stands in for checking every node of the file against the map, so even a
+// large database is ready as soon as it is mapped
+std::shared_ptr<const CompressedPathDatabase> CompressedPathDatabase::Load(const std::string& fileName, const MapSnapshot& snapshot, std::uint64_t mapHash) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(fileName)) {
+        std::cerr << "Error: Cannot open path database '" << fileName << "'." << std::endl;
+        return nullptr;
+    }
+
+    const GridLayout& layout = snapshot.GetLayout();
+    std::shared_ptr<CompressedPathDatabase> database(new CompressedPathDatabase());
+    database->m_version = snapshot.GetVersion();
+    Header header{};
+    if (!database->Attach(file, file->GetData(), file->GetSize(), header)) {
+        if (std::memcmp(header.magic, "CPD2", sizeof(header.magic)) == 0 && header.format != ImageFormat) {
+            std::cerr << "Error: Path database '" << fileName << "' was saved in format " << header.format << ", not " << ImageFormat << "." << std::endl;
+            return nullptr;
+        }
+        std::cerr << "Error: '" << fileName << "' is not a path database or is damaged." << std::endl;
+        return nullptr;
+    }
+    if (header.mapHash != mapHash || header.width != layout.width || header.height != layout.height || header.handleCount != layout.HandleCount()) {
+        std::cerr << "Error: Path database '" << fileName << "' was built for a different map." << std::endl;
+        return nullptr;
+    }
+    return database;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "Pathfinding.h"
+
+namespace AIForGames {
+
+    class MapSnapshot;
+    class WorkerPool;
+
+    // CompressedPathDatabase (CPD) stores the first move of a shortest path for every (source,
+    // target) pair, like NextHopTable, but compressed so that maps far too large for the full
+    // table still fit. Targets are numbered in depth-first order, which puts nearby nodes next
+    // to each other, and nearby targets are usually reached by the same first move. Each
+    // source's row is then run-length encoded as (first target, move) runs. Pairs without an
+    // answer (the source itself, other connected components) fit any run, so they never start one.
+    //
+    // A path is read out by repeated first-move lookups, each a binary search in one row. Rows
+    // are built in parallel with one Dijkstra search per source; building is quadratic in the
+    // node count, so the database is meant to be built offline, saved, and loaded with the map.
+    // Relies on every connection being two-way with the same cost both ways. The data lives in a
+    // binary image (see BinaryImage.h), so a saved database is used straight from the memory-mapped file
+    class CompressedPathDatabase
+    {
+    public:
+        static std::shared_ptr<const CompressedPathDatabase> Build(const MapSnapshot& snapshot, WorkerPool& pool); // Builds the database for a fully built snapshot
+        // Maps a database saved for a map with this content hash (see MapSnapshot::ComputeContentHash()).
+        // Returns null, with an error on the console, if the file cannot be read or is for another map
+        static std::shared_ptr<const CompressedPathDatabase> Load(const std::string& fileName, const MapSnapshot& snapshot, std::uint64_t mapHash);
+        bool Save(const std::string& fileName, std::uint64_t mapHash) const; // Writes the database to a binary file; false on failure
+
+        std::uint64_t GetVersion() const { return m_version; } // Map version the database describes
+        size_t GetNodeCount() const { return m_nodes.size(); } // Walkable nodes covered
+        size_t GetRunCount() const { return m_runs.size(); } // Runs over all rows
+        size_t GetMemoryUsage() const; // Bytes held by the runs and the node index (mapped from disk for loaded databases)
+        // Node after from on a shortest path to goal. InvalidNode if from is goal, either is not a
+        // node of this version, or goal cannot be reached. snapshot must be the version the database describes
+        NodeHandle GetNextHop(const MapSnapshot& snapshot, NodeHandle from, NodeHandle goal) const;
+        // Writes the whole path into outPath by following first moves
+        SearchStatus ExtractPath(const MapSnapshot& snapshot, NodeHandle start, NodeHandle goal, std::vector<NodeHandle>& outPath) const;
+
+    private:
+        static constexpr std::uint32_t NoIndex = 0xFFFFFFFFu; // m_orderOf value of cells that are not nodes
+        static constexpr int MoveBits = 2; // Connection slot of a run, in the low bits (an EdgeList holds at most four)
+
+        // Layout of the arrays in the image. Bumped whenever they or their encoding change, so
+        // files saved by an older build are rejected and rebuilt instead of being misread
+        static constexpr std::uint32_t ImageFormat = 1;
+
+        // Start of the image
+        struct Header {
+            char magic[4];
+            std::uint32_t format; // ImageFormat of the build that wrote it
+            std::uint64_t mapHash; // Content hash of the map; 0 until saved
+            std::int32_t width;
+            std::int32_t height;
+            std::uint64_t nodeCount;
+            std::uint64_t handleCount;
+            std::uint64_t runCount;
+        };
+
+        CompressedPathDatabase() = default;
+        // Points the database's arrays into an image kept alive by storage. False if the image is malformed
+        bool Attach(std::shared_ptr<const void> storage, const std::uint8_t* image, size_t size, Header& header);
+        std::uint32_t OrderOf(NodeHandle node) const { return node < m_orderOf.size() ? m_orderOf[node] : NoIndex; } // Depth-first number of a node
+        int GetMove(std::uint32_t from, std::uint32_t goal) const; // Connection slot to take from one node towards another
+
+        std::uint64_t m_version{ 0 };
+        std::shared_ptr<const void> m_storage; // Owns the image: a buffer in memory or a MappedFile
+        const std::uint8_t* m_image{ nullptr }; // The whole image, for Save()
+        size_t m_imageSize{ 0 };
+        std::span<const NodeHandle> m_nodes; // Handle of each node, in depth-first order
+        std::span<const std::uint32_t> m_orderOf; // Depth-first number of each handle, NoIndex for walls
+        std::span<const std::uint32_t> m_component; // Connected component of each node, by depth-first number
+        std::span<const std::uint64_t> m_rowStarts; // First run of each source's row, plus one past the last row
+        std::span<const std::uint32_t> m_runs; // (first target << MoveBits | move) for every run of every row
+    };
+}
@@ -0,0 +1,217 @@
+#include "GoalFieldCache.h"
+#include "MapSnapshot.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+using namespace AIForGames;
+
+std::shared_ptr<const GoalDistanceField> GoalDistanceField::Build(const MapSnapshot& snapshot, NodeHandle goal) {
+    std::shared_ptr<GoalDistanceField> field(new GoalDistanceField());
+    field->m_version = snapshot.GetVersion();
+    field->m_goal = goal;
+    field->m_distance.assign(snapshot.GetLayout().HandleCount(), FLT_MAX);
+
+    std::vector<std::pair<float, NodeHandle>> heap;
+    field->m_distance[goal] = 0.0f;
+    heap.emplace_back(0.0f, goal);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+        auto [distance, current] = heap.back();
+        heap.pop_back();
+        if (distance > field->m_distance[current]) continue; // Stale entry
+
+        for (const Edge& connection : snapshot.GetNodeData(current).connections) {
+            float tentative = distance + connection.cost;
+            if (tentative >= field->m_distance[connection.target]) continue;
+            field->m_distance[connection.target] = tentative;
+            heap.emplace_back(tentative, connection.target);
+            std::push_heap(heap.begin(), heap.end(), std::greater<>());
+        }
+    }
+    return field;
+}
+
+size_t GoalDistanceField::EstimateBytes(const MapSnapshot& snapshot) {
+    return sizeof(GoalDistanceField) + snapshot.GetLayout().HandleCount() * sizeof(float);
+}
+
+// Every step moves to a neighbour one connection closer, so the walk takes exactly the path
+// length and always ends at the goal
+SearchStatus GoalDistanceField::ExtractPath(const MapSnapshot& snapshot, NodeHandle start, std::vector<NodeHandle>& outPath) const {
+    outPath.clear();
+    if (GetDistance(start) == FLT_MAX) return SearchStatus::NoPath;
+
+    outPath.push_back(start);
+    for (NodeHandle current = start; current != m_goal;) {
+        NodeHandle next = InvalidNode;
+        float best = FLT_MAX;
+        for (const Edge& connection : snapshot.GetNodeData(current).connections) {
+            float remaining = GetDistance(connection.target);
+            if (remaining != FLT_MAX && remaining + connection.cost < best) {
+                best = remaining + connection.cost;
+                next = connection.target;
+            }
+        }
+        if (next == InvalidNode) {
+            // Only possible if snapshot is not the version the field was built on
+            outPath.clear();
+            return SearchStatus::NoPath;
+        }
+        current = next;
+        outPath.push_back(current);
+    }
+    return SearchStatus::Found;
+}
+
+GoalFieldCache::GoalFieldCache(size_t budgetBytes) {
+    SetBudget(budgetBytes);
+}
+
+// Builds still queued or running refer to this cache
+GoalFieldCache::~GoalFieldCache() {
+    WorkerPool::Shared().WaitForPosted();
+}
+
+void GoalFieldCache::SetBudget(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budgetBytes.store(budgetBytes, std::memory_order_relaxed);
+    if (budgetBytes == 0) {
+        m_goals.clear();
+        m_bytes = 0;
+        return;
+    }
+    MakeRoom(0, InvalidNode, UINT_MAX);
+}
+
+void GoalFieldCache::SetHotThreshold(unsigned int queries) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hotThreshold = std::max(queries, 1u);
+}
+
+// The query that makes a goal hot is not kept waiting for a whole-map search: it gets null, and
+// so does every later query for the goal until the field has been built in the background
+std::shared_ptr<const GoalDistanceField> GoalFieldCache::Acquire(const MapSnapshot& snapshot, NodeHandle goal) {
+    if (!IsEnabled()) return nullptr;
+
+    size_t fieldBytes = GoalDistanceField::EstimateBytes(snapshot);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.queries++;
+    if (++m_sinceDecay >= DecayInterval) Decay();
+
+    GoalEntry& entry = m_goals[goal];
+    entry.queries++;
+    if (entry.field && entry.field->GetVersion() != snapshot.GetVersion()) DropField(entry);
+    if (entry.field) {
+        m_stats.fieldHits++;
+        return entry.field;
+    }
+    if (entry.building || entry.queries < m_hotThreshold || snapshot.GetVersion() < m_minVersion || !MakeRoom(fieldBytes, goal, entry.queries)) {
+        return nullptr;
+    }
+
+    // The build keeps the snapshot alive; one that is not shared (e.g. on the stack) gets no field
+    std::shared_ptr<const MapSnapshot> pinned = snapshot.weak_from_this().lock();
+    if (!pinned) return nullptr;
+    entry.building = true;
+    WorkerPool::Shared().Post([this, pinned = std::move(pinned), goal]() { BuildField(*pinned, goal); });
+    return nullptr;
+}
+
+// Runs on the pool's background thread, outside the lock; queries keep being served meanwhile
+void GoalFieldCache::BuildField(const MapSnapshot& snapshot, NodeHandle goal) {
+    std::shared_ptr<const GoalDistanceField> field = GoalDistanceField::Build(snapshot, goal);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.fieldsBuilt++;
+    auto found = m_goals.find(goal);
+    if (found == m_goals.end()) return; // Forgotten while building, e.g. by SetBudget(0)
+    GoalEntry& entry = found->second;
+    entry.building = false;
+    if (snapshot.GetVersion() >= m_minVersion && MakeRoom(field->GetMemoryUsage(), goal, entry.queries)) {
+        entry.field = std::move(field);
+        m_bytes += entry.field->GetMemoryUsage();
+    }
+}
+
+// The goal asking for room may only displace fields of goals queried less often than itself
+bool GoalFieldCache::MakeRoom(size_t bytes, NodeHandle forGoal, unsigned int queries) {
+    size_t budget = m_budgetBytes.load(std::memory_order_relaxed);
+    if (bytes > budget) return false;
+    while (m_bytes + bytes > budget) {
+        GoalEntry* coldest = nullptr;
+        for (auto& [goal, entry] : m_goals) {
+            if (entry.field && goal != forGoal && (!coldest || entry.queries < coldest->queries)) coldest = &entry;
+        }
+        if (!coldest || coldest->queries >= queries) return false;
+        DropField(*coldest);
+        m_stats.evictions++;
+    }
+    return true;
+}
+
+void GoalFieldCache::DropField(GoalEntry& entry) {
+    m_bytes -= entry.field->GetMemoryUsage();
+    entry.field.reset();
+}
+
+void GoalFieldCache::Decay() {
+    m_sinceDecay = 0;
+    for (auto entry = m_goals.begin(); entry != m_goals.end();) {
+        entry->second.queries /= 2;
+        if (entry->second.queries == 0 && !entry->second.field && !entry->second.building) {
+            entry = m_goals.erase(entry);
+        }
+        else {
+            ++entry;
+        }
+    }
+}
+
+void GoalFieldCache::InvalidateBefore(std::uint64_t version) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_minVersion = std::max(m_minVersion, version);
+    for (auto& [goal, entry] : m_goals) {
+        if (entry.field && entry.field->GetVersion() < version) {
+            DropField(entry);
+            m_stats.invalidations++;
+        }
+    }
+}
+
+GoalFieldStats GoalFieldCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    GoalFieldStats stats = m_stats;
+    for (const auto& [goal, entry] : m_goals) {
+        stats.fields += entry.field ? 1 : 0;
+    }
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+std::vector<HotGoal> GoalFieldCache::GetHotGoals(size_t count) const {
+    std::vector<HotGoal> hot;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        hot.reserve(m_goals.size());
+        for (const auto& [goal, entry] : m_goals) {
+            hot.push_back({ goal, entry.queries, entry.field != nullptr });
+        }
+    }
+    count = std::min(count, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + count, hot.end(), [](const HotGoal& a, const HotGoal& b) { return a.queries > b.queries; });
+    hot.resize(count);
+    return hot;
+}
+
+size_t GoalFieldCache::GetMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes + m_goals.size() * (sizeof(NodeHandle) + sizeof(GoalEntry) + 2 * sizeof(void*)) + m_goals.bucket_count() * sizeof(void*);
+}
+
+void GoalFieldStats::Print(std::ostream& out) const {
+    out << "[GOAL FIELDS] " << fieldHits << " of " << queries << " queries answered from a field (" << HitRate() * 100.0 << "%), "
+        << fieldsBuilt << " built, " << evictions << " evicted, " << invalidations << " invalidated; " << fields << " fields, "
+        << bytes / 1024 << " KB\n";
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "Pathfinding.h"
+
+namespace AIForGames {
+
+    class MapSnapshot;
+
+    // Exact distance from every node of one map version to one goal, found by a single Dijkstra
+    // search out from the goal. With it a path to the goal needs no search: from any start, step
+    // to the neighbour whose distance plus the connection cost is lowest until the goal is reached.
+    // Stored densely by handle, so it costs four bytes per cell of every chunk. Relies on every
+    // connection being two-way with the same cost both ways
+    class GoalDistanceField
+    {
+    public:
+        static std::shared_ptr<const GoalDistanceField> Build(const MapSnapshot& snapshot, NodeHandle goal); // Runs the search
+        static size_t EstimateBytes(const MapSnapshot& snapshot); // Memory a field for this map would take
+
+        std::uint64_t GetVersion() const { return m_version; } // Map version the field describes
+        NodeHandle GetGoal() const { return m_goal; }
+        float GetDistance(NodeHandle node) const { return node < m_distance.size() ? m_distance[node] : FLT_MAX; } // FLT_MAX if node cannot reach the goal
+        size_t GetMemoryUsage() const { return sizeof(*this) + m_distance.size() * sizeof(float); }
+        // Writes the path from start to the goal into outPath by walking down the field. snapshot must be the version the field describes
+        SearchStatus ExtractPath(const MapSnapshot& snapshot, NodeHandle start, std::vector<NodeHandle>& outPath) const;
+
+    private:
+        GoalDistanceField() = default;
+
+        std::uint64_t m_version{ 0 };
+        NodeHandle m_goal{ InvalidNode };
+        std::vector<float> m_distance; // By handle; FLT_MAX for walls and unreachable nodes
+    };
+
+    // A goal and the number of recent queries for it
+    struct HotGoal {
+        NodeHandle goal{ InvalidNode };
+        unsigned int queries{ 0 }; // Recent queries (counts halve every GoalFieldCache::DecayInterval queries)
+        bool hasField{ false }; // True if the goal currently has a distance field
+    };
+
+    // Counters of a GoalFieldCache
+    struct GoalFieldStats {
+        size_t queries{ 0 }; // Queries counted
+        size_t fieldHits{ 0 }; // Queries answered from a field, with no search
+        size_t fieldsBuilt{ 0 }; // Fields computed
+        size_t evictions{ 0 }; // Fields dropped for hotter goals
+        size_t invalidations{ 0 }; // Fields dropped because the map changed
+        size_t fields{ 0 }; // Fields currently held
+        size_t bytes{ 0 }; // Memory of the held fields
+
+        double HitRate() const { return queries > 0 ? static_cast<double>(fieldHits) / queries : 0.0; } // Share of queries needing no search
+        void Print(std::ostream& out) const; // Writes the counters as one console line
+    };
+
+    // GoalFieldCache counts how often each goal is queried and keeps distance fields for the
+    // hottest ones within a memory budget. A goal gets a field once it has been asked for
+    // hotThreshold times; if that would exceed the budget, the field of a colder goal is dropped,
+    // and if every held field is at least as hot, the goal goes without. Counts halve every
+    // DecayInterval queries, so destinations that stop being popular cool down and make room.
+    // Fields are built on the shared pool's background thread, one build per goal; until a
+    // goal's field is in place its queries are searched as usual
+    class GoalFieldCache
+    {
+    public:
+        static constexpr unsigned int DefaultHotThreshold = 32; // Queries before a goal gets a field
+        static constexpr size_t DecayInterval = 8192; // Queries between halvings of every count
+
+        explicit GoalFieldCache(size_t budgetBytes = 0); // 0 disables the cache
+        ~GoalFieldCache(); // Waits for builds in progress
+        GoalFieldCache(const GoalFieldCache&) = delete;
+        GoalFieldCache& operator=(const GoalFieldCache&) = delete;
+
+        bool IsEnabled() const { return m_budgetBytes.load(std::memory_order_relaxed) > 0; } // False while the budget is 0
+        void SetBudget(size_t budgetBytes); // Changes the bound, dropping the coldest fields if needed; 0 disables and empties the cache
+        void SetHotThreshold(unsigned int queries); // Queries before a goal gets a field
+        // Counts a query for goal and returns the goal's field for snapshot's version. Null if the
+        // goal has no field yet; one that has just become hot has its field built in the background
+        std::shared_ptr<const GoalDistanceField> Acquire(const MapSnapshot& snapshot, NodeHandle goal);
+        void InvalidateBefore(std::uint64_t version); // Drops every field of an older version (counts are kept)
+        GoalFieldStats GetStats() const; // Counters and current size
+        std::vector<HotGoal> GetHotGoals(size_t count) const; // The most queried goals, hottest first
+        size_t GetMemoryUsage() const; // Bytes held by the fields and the counters
+
+    private:
+        struct GoalEntry {
+            unsigned int queries{ 0 };
+            bool building{ false }; // This goal's field is queued or being built
+            std::shared_ptr<const GoalDistanceField> field;
+        };
+
+        void BuildField(const MapSnapshot& snapshot, NodeHandle goal); // Computes a goal's field and stores it if there is still room
+        void Decay(); // Halves every count and forgets cold goals without a field. Called with the lock held
+        void DropField(GoalEntry& entry); // Called with the lock held
+        bool MakeRoom(size_t bytes, NodeHandle forGoal, unsigned int queries); // Drops colder fields until bytes fit. Called with the lock held
+
+        std::atomic<size_t> m_budgetBytes{ 0 }; // Written under the lock, read without it by IsEnabled()
+        mutable std::mutex m_mutex; // Guards everything below
+        unsigned int m_hotThreshold{ DefaultHotThreshold };
+        std::uint64_t m_minVersion{ 0 }; // Oldest version whose fields are kept
+        std::unordered_map<NodeHandle, GoalEntry> m_goals; // Counts and fields by goal
+        size_t m_bytes{ 0 }; // Memory of the held fields
+        size_t m_sinceDecay{ 0 }; // Queries since the last halving
+        GoalFieldStats m_stats; // fields and bytes are filled in by GetStats()
+    };
+}
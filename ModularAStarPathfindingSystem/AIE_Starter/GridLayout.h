@@ -0,0 +1,55 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "Pathfinding.h"
+
+namespace AIForGames {
+
+    // GridLayout converts between grid coordinates and NodeHandles. The map is split into
+    // square chunks of ChunkSize x ChunkSize cells; a handle stores the chunk index in its
+    // upper bits and the cell's position inside the chunk in its lower LocalBits bits, so
+    // every cell of a chunk shares one block of handles. Maps up to 65535 x 65535 cells fit
+    // in a 32-bit handle, leaving the all-ones value free for InvalidNode. All conversions are plain arithmetic and need no map data.
+    struct GridLayout {
+        static constexpr int ChunkShift = 6; // log2 of the chunk size
+        static constexpr int ChunkSize = 1 << ChunkShift; // Cells along each side of a chunk
+        static constexpr int LocalBits = ChunkShift * 2; // Handle bits used for the cell within its chunk
+        static constexpr int ChunkCells = 1 << LocalBits; // Cells per chunk
+        static constexpr int MaxDimension = 65535; // Largest width or height a handle can address
+
+        int width{ 0 }; // Map width in cells
+        int height{ 0 }; // Map height in cells
+        int chunksX{ 0 }; // Chunks per row of the map
+        int chunksY{ 0 }; // Chunks per column of the map
+
+        GridLayout() = default;
+        GridLayout(int _width, int _height) : width(_width), height(_height),
+            chunksX((_width + ChunkSize - 1) >> ChunkShift), chunksY((_height + ChunkSize - 1) >> ChunkShift) {}
+
+        size_t ChunkCount() const { return static_cast<size_t>(chunksX) * static_cast<size_t>(chunksY); } // Number of chunks, including empty ones
+        size_t CellCount() const { return static_cast<size_t>(width) * static_cast<size_t>(height); } // Number of cells (64-bit safe)
+        size_t HandleCount() const { return ChunkCount() << LocalBits; } // Upper bound of the handle range
+        bool Contains(int x, int y) const { return x >= 0 && x < width && y >= 0 && y < height; } // True if (x, y) is on the map
+
+        // Handle of the cell at (x, y). The cell must be on the map
+        NodeHandle ToHandle(int x, int y) const {
+            NodeHandle chunk = static_cast<NodeHandle>((y >> ChunkShift) * chunksX + (x >> ChunkShift));
+            NodeHandle local = static_cast<NodeHandle>(((y & (ChunkSize - 1)) << ChunkShift) | (x & (ChunkSize - 1)));
+            return (chunk << LocalBits) | local;
+        }
+
+        // Grid coordinates of a handle
+        glm::ivec2 ToCoords(NodeHandle node) const {
+            int chunk = static_cast<int>(node >> LocalBits);
+            int local = static_cast<int>(node & (ChunkCells - 1));
+            return glm::ivec2(
+                ((chunk % chunksX) << ChunkShift) | (local & (ChunkSize - 1)),
+                ((chunk / chunksX) << ChunkShift) | (local >> ChunkShift)
+            );
+        }
+
+        static size_t ChunkOf(NodeHandle node) { return node >> LocalBits; } // Index of the chunk holding a handle
+        static int LocalOf(NodeHandle node) { return static_cast<int>(node & (ChunkCells - 1)); } // Cell index inside its chunk
+    };
+}
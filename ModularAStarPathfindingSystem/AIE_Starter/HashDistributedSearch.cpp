@@ -0,0 +1,185 @@
+#include "HashDistributedSearch.h"
+#include "MapSnapshot.h"
+#include "SearchContext.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace AIForGames;
+
+namespace {
+    // Manhattan distance in cells times the cheapest edge cost, as in the serial search
+    float Heuristic(const MapSnapshot& snapshot, NodeHandle node, glm::ivec2 endCoords) {
+        glm::ivec2 diff = snapshot.GetLayout().ToCoords(node) - endCoords;
+        return static_cast<float>(std::abs(diff.x) + std::abs(diff.y)) * snapshot.GetMinEdgeCost();
+    }
+}
+
+HashDistributedSearch::HashDistributedSearch() = default;
+HashDistributedSearch::~HashDistributedSearch() = default;
+
+// Neighbouring cells mostly share a 4x4 block and therefore an owner, so most relaxations stay
+// local, while the hash still scatters the blocks evenly over the workers
+unsigned int HashDistributedSearch::OwnerOf(NodeHandle node) const {
+    int local = GridLayout::LocalOf(node);
+    std::uint64_t block = (GridLayout::ChunkOf(node) << 8) | ((local >> (GridLayout::ChunkShift + 2)) << 4) | ((local & (GridLayout::ChunkSize - 1)) >> 2);
+    return static_cast<unsigned int>(((block * 0x9E3779B97F4A7C15ull) >> 32) % m_workers.size());
+}
+
+SearchStatus HashDistributedSearch::Run(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath,
+    WorkerPool& pool, const CancellationToken& cancel, size_t& peakBytes, size_t& expansions) {
+    outPath.clear();
+    peakBytes = 0;
+    expansions = 0;
+    if (!snapshot.IsValidNode(startNode) || !snapshot.IsValidNode(endNode)) {
+        std::cerr << "Error: Start or End node is invalid." << std::endl;
+        return SearchStatus::InvalidEndpoints;
+    }
+
+    unsigned int workerCount = pool.GetWorkerCount();
+    while (m_workers.size() < workerCount) {
+        m_workers.push_back(std::make_unique<Worker>());
+        m_workers.back()->context = std::make_unique<SearchContext>();
+    }
+    m_workers.resize(workerCount);
+
+    const GridLayout& layout = snapshot.GetLayout();
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        worker->context->Begin(layout.ChunkCount());
+        worker->outboxes.resize(workerCount);
+        worker->expansions = 0;
+        for (std::vector<Message>& outbox : worker->outboxes) {
+            outbox.clear();
+        }
+    }
+
+    m_snapshot = &snapshot;
+    m_endNode = endNode;
+    m_endCoords = layout.ToCoords(endNode);
+    m_cancel = &cancel;
+    m_outstanding = workerCount; // Every worker starts out active
+    m_bestCost = FLT_MAX;
+    m_cancelled = false;
+    m_workers[OwnerOf(startNode)]->context->Open(startNode, 0.0f, Heuristic(snapshot, startNode, m_endCoords), InvalidNode);
+
+    // Each index is one search worker. No index finishes before the search does, so the pool
+    // runs them all at once on separate threads
+    pool.ParallelFor(workerCount, [this](size_t index, unsigned int) {
+        RunWorker(static_cast<unsigned int>(index));
+        });
+
+    SearchStatus status = m_cancelled ? SearchStatus::Cancelled : m_bestCost < FLT_MAX ? SearchStatus::Found : SearchStatus::NoPath;
+    if (status == SearchStatus::Found) {
+        // Each node's predecessor is kept by the node's owner
+        for (NodeHandle currentNode = endNode; currentNode != InvalidNode; currentNode = m_workers[OwnerOf(currentNode)]->context->GetPrevious(currentNode)) {
+            outPath.push_back(currentNode);
+        }
+        std::reverse(outPath.begin(), outPath.end());
+    }
+
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        peakBytes += worker->context->End();
+        expansions += worker->expansions;
+        worker->inbox.ConsumeAll([](std::vector<Message>&) {}); // Batches left over by a cancelled search
+    }
+    return status;
+}
+
+// m_outstanding counts active workers plus batches in flight. A worker adds a batch before
+// sending it and removes batches only after taking them in, and an idle worker adds itself
+// back before it takes in anything, so the count cannot reach zero while work remains. Once it
+// is zero nothing can raise it again, and every open node left costs at least the best path
+void HashDistributedSearch::RunWorker(unsigned int index) {
+    Worker& self = *m_workers[index];
+    SearchContext& context = *self.context;
+    const MapSnapshot& snapshot = *m_snapshot;
+    size_t& expansions = self.expansions;
+
+    for (;;) {
+        size_t batches = self.inbox.ConsumeAll([&](std::vector<Message>& batch) {
+            for (const Message& message : batch) {
+                Relax(context, message.node, message.gScore, message.previous);
+            }
+            });
+        if (batches > 0) {
+            m_outstanding -= static_cast<std::int64_t>(batches);
+        }
+        if (m_cancelled.load(std::memory_order_relaxed)) return;
+
+        if (context.PeekOpenFScore() < m_bestCost.load(std::memory_order_relaxed)) {
+            NodeHandle currentNode = context.PopOpen();
+            if (currentNode == InvalidNode) continue; // Only stale entries were left
+
+            if ((++expansions & (FlushInterval - 1)) == 0) {
+                if (m_cancel->IsCancelled()) {
+                    m_cancelled = true;
+                    return;
+                }
+                for (unsigned int destination = 0; destination < m_workers.size(); destination++) {
+                    Send(self, destination);
+                }
+            }
+
+            float currentGScore = context.GetGScore(currentNode);
+            if (currentNode == m_endNode) {
+                // A shorter path may still arrive, so the goal only tightens the bound
+                float best = m_bestCost.load();
+                while (currentGScore < best && !m_bestCost.compare_exchange_weak(best, currentGScore)) {}
+                continue;
+            }
+
+            for (const Edge& connection : snapshot.GetNodeData(currentNode).connections) {
+                NodeHandle targetNode = connection.target;
+                float tentative_gScore = currentGScore + connection.cost;
+                unsigned int owner = OwnerOf(targetNode);
+                if (owner == index) {
+                    Relax(context, targetNode, tentative_gScore, currentNode);
+                    continue;
+                }
+
+                std::vector<Message>& outbox = self.outboxes[owner];
+                outbox.push_back(Message{ targetNode, currentNode, tentative_gScore });
+                if (outbox.size() >= BatchSize) {
+                    Send(self, owner);
+                }
+            }
+            continue;
+        }
+
+        // Nothing useful left to expand: hand over everything collected, then wait for work
+        for (unsigned int destination = 0; destination < m_workers.size(); destination++) {
+            Send(self, destination);
+        }
+        m_outstanding--;
+        for (;;) {
+            if (!self.inbox.IsEmpty()) {
+                m_outstanding++;
+                break;
+            }
+            if (m_outstanding.load() == 0 || m_cancelled.load(std::memory_order_relaxed)) return;
+            std::this_thread::yield();
+        }
+    }
+}
+
+void HashDistributedSearch::Relax(SearchContext& context, NodeHandle node, float gScore, NodeHandle previous) {
+    if (gScore >= context.GetGScore(node)) return;
+
+    float fScore = gScore + Heuristic(*m_snapshot, node, m_endCoords);
+    if (fScore < m_bestCost.load(std::memory_order_relaxed)) {
+        context.Open(node, gScore, fScore, previous);
+    }
+}
+
+void HashDistributedSearch::Send(Worker& worker, unsigned int destination) {
+    std::vector<Message>& outbox = worker.outboxes[destination];
+    if (outbox.empty()) return;
+
+    m_outstanding++;
+    m_workers[destination]->inbox.Push(std::move(outbox));
+    outbox = std::vector<Message>();
+    outbox.reserve(BatchSize);
+}
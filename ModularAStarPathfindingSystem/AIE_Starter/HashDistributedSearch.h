@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Pathfinding.h"
+#include "CancellationToken.h"
+#include "MpscQueue.h"
+
+namespace AIForGames {
+
+    class MapSnapshot;
+    class SearchContext;
+    class WorkerPool;
+
+    // HashDistributedSearch runs one A* query on every worker of a WorkerPool at once (HDA*).
+    // Each node belongs to one worker, chosen by hashing the 4x4 block of cells it lies in, and
+    // only its owner keeps its score and opens it. A worker expands nodes from its own open list;
+    // improvements to nodes owned by other workers are collected per destination and sent in
+    // batches through lock-free inboxes. Once the goal is reached its cost bounds the search, and
+    // the workers carry on until no open node could still beat it. The search ends when every
+    // worker is idle and no batch is in flight, which a single counter detects.
+    //
+    // One search runs at a time per instance. Worth it for long queries only: short ones spend
+    // more time exchanging messages than expanding nodes.
+    class HashDistributedSearch
+    {
+    public:
+        static constexpr size_t BatchSize = 64; // Messages collected for a worker before they are sent
+        static constexpr unsigned int FlushInterval = 256; // Expansions between sending partly filled batches
+
+        HashDistributedSearch();
+        ~HashDistributedSearch();
+        HashDistributedSearch(const HashDistributedSearch&) = delete;
+        HashDistributedSearch& operator=(const HashDistributedSearch&) = delete;
+
+        // Finds an optimal path using every worker of the pool. Must not be called from a task
+        // running on that pool. peakBytes and expansions receive the totals of all workers
+        SearchStatus Run(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath,
+            WorkerPool& pool, const CancellationToken& cancel, size_t& peakBytes, size_t& expansions);
+
+    private:
+        // A better path to a node, sent to the node's owner
+        struct Message {
+            NodeHandle node;
+            NodeHandle previous;
+            float gScore;
+        };
+
+        // State of one worker. Only its inbox is touched by other workers, so it gets a cache line
+        // of its own, apart from the fields the worker updates as it searches
+        struct alignas(64) Worker {
+            std::unique_ptr<SearchContext> context; // Scores and open list of the nodes this worker owns
+            alignas(64) MpscQueue<std::vector<Message>> inbox; // Batches sent by other workers
+            std::vector<std::vector<Message>> outboxes; // Batches being filled, one per destination worker
+            size_t expansions{ 0 }; // Nodes this worker expanded in the current search
+        };
+
+        unsigned int OwnerOf(NodeHandle node) const; // Worker that owns a node
+        void RunWorker(unsigned int index); // Expands and exchanges nodes until the search ends
+        void Relax(SearchContext& context, NodeHandle node, float gScore, NodeHandle previous); // Opens a node this worker owns if the path is better
+        void Send(Worker& worker, unsigned int destination); // Sends a worker's batch for one destination, if it holds anything
+
+        std::vector<std::unique_ptr<Worker>> m_workers; // One per pool worker, kept between searches
+        const MapSnapshot* m_snapshot{ nullptr }; // Version being searched
+        NodeHandle m_endNode{ InvalidNode };
+        glm::ivec2 m_endCoords{ 0 }; // Grid coordinates of m_endNode, for the heuristic
+        const CancellationToken* m_cancel{ nullptr };
+        std::atomic<std::int64_t> m_outstanding{ 0 }; // Active workers plus batches sent but not yet taken in; zero means done
+        std::atomic<float> m_bestCost{ 0.0f }; // Cost of the best path to the goal so far
+        std::atomic<bool> m_cancelled{ false }; // Set by the first worker to see the token cancelled
+    };
+}
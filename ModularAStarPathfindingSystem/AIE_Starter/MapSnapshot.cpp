@@ -0,0 +1,356 @@
+#include "MapSnapshot.h"
+#include "WorkerPool.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace AIForGames;
+
+// Creates a map of the given size in which every cell is a wall
+MapSnapshot::MapSnapshot(const GridLayout& layout, std::uint64_t version)
+    : m_layout(layout), m_version(version), m_chunks(layout.ChunkCount()) {}
+
+// Records walkability as one bit per cell, a row of the chunk per 64-bit word. Chunks that
+// are entirely wall are never stored. Each task reads one band of GridLayout::ChunkSize map
+// rows and fills only that band's slots of the pre-sized chunk table, so tasks share no writes
+std::shared_ptr<MapSnapshot> MapSnapshot::Create(const GridLayout& layout, std::uint64_t version, const std::function<bool(int x, int y)>& isWalkable, WorkerPool& pool) {
+    std::shared_ptr<MapSnapshot> snapshot = std::make_shared<MapSnapshot>(layout, version);
+
+    std::vector<size_t> allocatedPerBand(layout.chunksY, 0);
+    pool.ParallelFor(layout.chunksY, [&](size_t band, unsigned int) {
+        int chunkY = static_cast<int>(band);
+        std::shared_ptr<Chunk> chunk;
+        for (int chunkX = 0; chunkX < layout.chunksX; chunkX++) {
+            if (!chunk) {
+                chunk = std::make_shared<Chunk>();
+                chunk->version = version;
+            }
+
+            int originX = chunkX << GridLayout::ChunkShift;
+            int originY = chunkY << GridLayout::ChunkShift;
+            int columns = std::min(GridLayout::ChunkSize, layout.width - originX);
+            int rows = std::min(GridLayout::ChunkSize, layout.height - originY);
+            bool anyWalkable = false;
+            for (int localY = 0; localY < GridLayout::ChunkSize; localY++) {
+                std::uint64_t bits = 0;
+                for (int localX = 0; localX < columns && localY < rows; localX++) {
+                    if (isWalkable(originX + localX, originY + localY)) {
+                        bits |= std::uint64_t(1) << localX;
+                    }
+                }
+                chunk->walkableRows[localY] = bits;
+                anyWalkable = anyWalkable || bits != 0;
+            }
+
+            // An all-wall chunk's buffer is reused for the next one
+            if (anyWalkable) {
+                FinishChunk(*chunk);
+                snapshot->m_chunks[static_cast<size_t>(chunkY) * layout.chunksX + chunkX] = std::move(chunk);
+                allocatedPerBand[band]++;
+            }
+        }
+        });
+
+    for (size_t allocated : allocatedPerBand) {
+        snapshot->m_allocatedChunks += allocated;
+    }
+    return snapshot;
+}
+
+// Copies the chunk table only. Chunks are copied by the edits themselves, so a version that
+// changes a few cells costs a few chunks however large the map is
+std::shared_ptr<MapSnapshot> MapSnapshot::BeginEdits(std::uint64_t version) const {
+    std::shared_ptr<MapSnapshot> next = std::make_shared<MapSnapshot>(*this);
+    next->m_version = version;
+    return next;
+}
+
+// Copies the chunk on this version's first edit to it. A built chunk is copied with its nodes,
+// and so its edge costs, moved into one slot per cell; an unbuilt one only needs its walkability,
+// since building it later gives every edge the default cost. An all-wall chunk starts out empty
+MapSnapshot::Chunk* MapSnapshot::EditableChunk(int x, int y) {
+    if (!m_layout.Contains(x, y)) return nullptr;
+    std::shared_ptr<Chunk>& slot = m_chunks[static_cast<size_t>(y >> GridLayout::ChunkShift) * m_layout.chunksX + (x >> GridLayout::ChunkShift)];
+    if (slot && slot->version == m_version) return slot.get();
+
+    std::shared_ptr<Chunk> copy = std::make_shared<Chunk>();
+    copy->version = m_version;
+    if (const Chunk* original = slot.get()) {
+        std::copy(std::begin(original->walkableRows), std::end(original->walkableRows), copy->walkableRows);
+        std::copy(std::begin(original->rowOffsets), std::end(original->rowOffsets), copy->rowOffsets);
+        if (original->built.load(std::memory_order_acquire)) {
+            if (original->cellSlots) {
+                copy->nodes = original->nodes;
+            }
+            else {
+                copy->nodes.resize(GridLayout::ChunkCells);
+                size_t nodeIndex = 0;
+                for (int localY = 0; localY < GridLayout::ChunkSize; localY++) {
+                    for (std::uint64_t bits = original->walkableRows[localY]; bits != 0; bits &= bits - 1) {
+                        copy->nodes[(localY << GridLayout::ChunkShift) | std::countr_zero(bits)] = original->nodes[nodeIndex++];
+                    }
+                }
+            }
+            copy->cellSlots = true;
+            copy->built.store(true, std::memory_order_relaxed);
+        }
+    }
+    else {
+        m_allocatedChunks++;
+    }
+    slot = std::move(copy);
+    return slot.get();
+}
+
+// Nobody else can see an editable chunk yet, so it is built without its mutex
+void MapSnapshot::BuildEditableChunk(Chunk& chunk, size_t chunkIndex) const {
+    if (chunk.built.load(std::memory_order_relaxed)) return;
+    chunk.cellSlots = true;
+    BuildChunk(chunk, chunkIndex);
+    chunk.built.store(true, std::memory_order_relaxed);
+}
+
+// Connections are listed west, north, east, south as in BuildChunk(), so an edited map holds
+// exactly the graph a fresh build of it would. Connections that survive keep their cost
+void MapSnapshot::RelinkNode(Chunk& chunk, int x, int y) const {
+    Node& node = chunk.nodes[GridLayout::LocalOf(m_layout.ToHandle(x, y))];
+    EdgeList previous = node.connections;
+    node.connections = EdgeList();
+    if (!IsWalkable(x, y)) return;
+
+    const glm::ivec2 neighbours[] = { { x - 1, y }, { x, y - 1 }, { x + 1, y }, { x, y + 1 } };
+    for (const glm::ivec2& neighbour : neighbours) {
+        if (!IsWalkable(neighbour.x, neighbour.y)) continue;
+        NodeHandle target = m_layout.ToHandle(neighbour.x, neighbour.y);
+        auto kept = std::find_if(previous.begin(), previous.end(), [target](const Edge& connection) { return connection.target == target; });
+        node.ConnectTo(target, kept != previous.end() ? kept->cost : 1.0f);
+    }
+}
+
+// Only the cell's chunk and the chunks of its walkable neighbours are copied: those neighbours
+// hold edges to the cell, or will once built, and an unbuilt chunk shared with the previous
+// version could otherwise be built from the old walkability. A wall neighbour has no node, so
+// its chunk stays shared. Apart from the copies, an edit relinks at most five nodes
+bool MapSnapshot::SetWalkable(int x, int y, bool walkable) {
+    if (!m_layout.Contains(x, y)) {
+        std::cerr << "Error: Tile edit at " << x << "," << y << " is out of bounds." << std::endl;
+        return false;
+    }
+    if (IsWalkable(x, y) == walkable) return true;
+
+    Chunk& chunk = *EditableChunk(x, y);
+    const glm::ivec2 neighbours[] = { { x - 1, y }, { x, y - 1 }, { x + 1, y }, { x, y + 1 } };
+    Chunk* neighbourChunks[4] = {};
+    for (int i = 0; i < 4; i++) {
+        if (IsWalkable(neighbours[i].x, neighbours[i].y)) {
+            neighbourChunks[i] = EditableChunk(neighbours[i].x, neighbours[i].y);
+        }
+    }
+
+    std::uint64_t bit = std::uint64_t(1) << (x & (GridLayout::ChunkSize - 1));
+    std::uint64_t& row = chunk.walkableRows[y & (GridLayout::ChunkSize - 1)];
+    row = walkable ? (row | bit) : (row & ~bit);
+    if (chunk.built.load(std::memory_order_relaxed)) {
+        RelinkNode(chunk, x, y);
+    }
+    else {
+        FinishChunk(chunk);
+    }
+    for (int i = 0; i < 4; i++) {
+        if (neighbourChunks[i] && neighbourChunks[i]->built.load(std::memory_order_relaxed)) {
+            RelinkNode(*neighbourChunks[i], neighbours[i].x, neighbours[i].y);
+        }
+    }
+
+    // A chunk that ended up entirely wall is dropped, like at load time. Its cells had no
+    // walkable neighbour left inside it, and those outside were relinked above
+    if (!walkable && row == 0 && std::none_of(std::begin(chunk.walkableRows), std::end(chunk.walkableRows), [](std::uint64_t bits) { return bits != 0; })) {
+        m_chunks[static_cast<size_t>(y >> GridLayout::ChunkShift) * m_layout.chunksX + (x >> GridLayout::ChunkShift)].reset();
+        m_allocatedChunks--;
+    }
+    return true;
+}
+
+// Costs live in built nodes, so both chunks are built if they were not already. The cost is set
+// in both directions, keeping every connection two-way with one cost as the reverse searches need
+bool MapSnapshot::SetEdgeCost(int x, int y, int toX, int toY, float cost) {
+    if (!(cost > 0.0f) || !std::isfinite(cost)) {
+        std::cerr << "Error: Edge cost " << cost << " must be positive and finite." << std::endl;
+        return false;
+    }
+    if (std::abs(toX - x) + std::abs(toY - y) != 1 || !IsWalkable(x, y) || !IsWalkable(toX, toY)) {
+        std::cerr << "Error: Cells " << x << "," << y << " and " << toX << "," << toY << " are not connected." << std::endl;
+        return false;
+    }
+
+    const glm::ivec2 ends[] = { { x, y }, { toX, toY } };
+    for (int i = 0; i < 2; i++) {
+        glm::ivec2 from = ends[i];
+        glm::ivec2 to = ends[1 - i];
+        Chunk& chunk = *EditableChunk(from.x, from.y);
+        BuildEditableChunk(chunk, static_cast<size_t>(from.y >> GridLayout::ChunkShift) * m_layout.chunksX + (from.x >> GridLayout::ChunkShift));
+        NodeHandle target = m_layout.ToHandle(to.x, to.y);
+        for (Edge& connection : chunk.nodes[GridLayout::LocalOf(m_layout.ToHandle(from.x, from.y))].connections) {
+            if (connection.target == target) connection.cost = cost;
+        }
+    }
+    m_minEdgeCost = std::min(m_minEdgeCost, cost);
+    return true;
+}
+
+// Stores how many nodes precede each row, so a cell's node index is one popcount away
+void MapSnapshot::FinishChunk(Chunk& chunk) {
+    int count = 0;
+    for (int localY = 0; localY < GridLayout::ChunkSize; localY++) {
+        chunk.rowOffsets[localY] = static_cast<std::uint16_t>(count);
+        count += std::popcount(chunk.walkableRows[localY]);
+    }
+}
+
+// Returns the chunk holding a node, building its nodes and edges on first use. After the
+// first build this is a single atomic load, so concurrent searches only contend once per chunk
+const MapSnapshot::Chunk& MapSnapshot::GetBuiltChunk(NodeHandle node) const {
+    size_t chunkIndex = GridLayout::ChunkOf(node);
+    Chunk& chunk = *m_chunks[chunkIndex];
+    if (!chunk.built.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(chunk.buildMutex);
+        if (!chunk.built.load(std::memory_order_relaxed)) {
+            BuildChunk(chunk, chunkIndex);
+            chunk.built.store(true, std::memory_order_release);
+        }
+    }
+    return chunk;
+}
+
+// Creates one node per walkable cell and connects it to its walkable orthogonal neighbours.
+// Neighbours in other chunks are found through their walkability bits and handle arithmetic,
+// so building a chunk never needs (or builds) any other chunk
+void MapSnapshot::BuildChunk(Chunk& chunk, size_t chunkIndex) const {
+    int lastRow = GridLayout::ChunkSize - 1;
+    size_t nodeCount = chunk.rowOffsets[lastRow] + std::popcount(chunk.walkableRows[lastRow]);
+    chunk.nodes.assign(chunk.cellSlots ? GridLayout::ChunkCells : nodeCount, Node());
+
+    int originX = static_cast<int>(chunkIndex % m_layout.chunksX) << GridLayout::ChunkShift;
+    int originY = static_cast<int>(chunkIndex / m_layout.chunksX) << GridLayout::ChunkShift;
+    size_t nodeIndex = 0;
+    for (int localY = 0; localY < GridLayout::ChunkSize; localY++) {
+        for (std::uint64_t bits = chunk.walkableRows[localY]; bits != 0; bits &= bits - 1) {
+            int localX = std::countr_zero(bits);
+            int x = originX + localX;
+            int y = originY + localY;
+            Node& node = chunk.nodes[chunk.cellSlots ? (localY << GridLayout::ChunkShift) | localX : nodeIndex++];
+
+            // Connect to the west, north, east and south nodes with a default weight of 1
+            const glm::ivec2 neighbours[] = { { x - 1, y }, { x, y - 1 }, { x + 1, y }, { x, y + 1 } };
+            for (const glm::ivec2& neighbour : neighbours) {
+                if (IsWalkable(neighbour.x, neighbour.y)) {
+                    node.ConnectTo(m_layout.ToHandle(neighbour.x, neighbour.y), 1);
+                }
+            }
+        }
+    }
+}
+
+// Returns true if the cell at (x, y) is on the map and walkable
+bool MapSnapshot::IsWalkable(int x, int y) const {
+    if (!m_layout.Contains(x, y))
+        return false;
+    const Chunk* chunk = m_chunks[static_cast<size_t>(y >> GridLayout::ChunkShift) * m_layout.chunksX + (x >> GridLayout::ChunkShift)].get();
+    return chunk != nullptr && (chunk->walkableRows[y & (GridLayout::ChunkSize - 1)] >> (x & (GridLayout::ChunkSize - 1)) & 1) != 0;
+}
+
+// Handles stay meaningful across versions, but the cell behind one may have become a wall
+bool MapSnapshot::IsValidNode(NodeHandle node) const {
+    if (node == InvalidNode || GridLayout::ChunkOf(node) >= m_chunks.size())
+        return false;
+    glm::ivec2 coords = m_layout.ToCoords(node);
+    return IsWalkable(coords.x, coords.y);
+}
+
+// Retrieves the node at the specified (x, y) grid position
+NodeHandle MapSnapshot::GetNode(int x, int y) const {
+    if (!IsWalkable(x, y))
+        return InvalidNode; // Return InvalidNode if out of bounds or a wall
+    return m_layout.ToHandle(x, y);
+}
+
+// Returns the node for a handle. Nodes are stored densely per chunk, so the node's index is
+// the number of walkable cells before it in the chunk, except in chunks copied by an edit
+const Node& MapSnapshot::GetNodeData(NodeHandle node) const {
+    const Chunk& chunk = GetBuiltChunk(node);
+    int local = GridLayout::LocalOf(node);
+    if (chunk.cellSlots) return chunk.nodes[local];
+    int localY = local >> GridLayout::ChunkShift;
+    std::uint64_t earlierInRow = chunk.walkableRows[localY] & ((std::uint64_t(1) << (local & (GridLayout::ChunkSize - 1))) - 1);
+    return chunk.nodes[chunk.rowOffsets[localY] + std::popcount(earlierInRow)];
+}
+
+// Each chunk's nodes go into its own vector, sized from its row offsets before any edge is
+// added, so chunks can be built in any order on any worker
+void MapSnapshot::BuildAllChunks(WorkerPool& pool) const {
+    pool.ParallelFor(m_chunks.size(), [this](size_t chunkIndex, unsigned int) {
+        if (m_chunks[chunkIndex]) {
+            GetBuiltChunk(static_cast<NodeHandle>(chunkIndex << GridLayout::LocalBits));
+        }
+        });
+}
+
+// Chunks are hashed in parallel and their hashes combined in chunk order, so the result does
+// not depend on the worker count. Empty chunks contribute their index only
+std::uint64_t MapSnapshot::ComputeContentHash(WorkerPool& pool) const {
+    auto mix = [](std::uint64_t hash, std::uint64_t value) {
+        // splitmix64 finaliser over the running hash and the next value
+        hash += value + 0x9E3779B97F4A7C15ull;
+        hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+        return hash ^ (hash >> 31);
+        };
+
+    std::vector<std::uint64_t> chunkHashes(m_chunks.size());
+    pool.ParallelFor(m_chunks.size(), [&](size_t chunkIndex, unsigned int) {
+        std::uint64_t hash = mix(0, chunkIndex);
+        if (m_chunks[chunkIndex]) {
+            const Chunk& chunk = GetBuiltChunk(static_cast<NodeHandle>(chunkIndex << GridLayout::LocalBits));
+            for (std::uint64_t row : chunk.walkableRows) {
+                hash = mix(hash, row);
+            }
+            for (const Node& node : chunk.nodes) {
+                for (const Edge& connection : node.connections) {
+                    std::uint32_t costBits;
+                    std::memcpy(&costBits, &connection.cost, sizeof(costBits));
+                    hash = mix(hash, (std::uint64_t(connection.target) << 32) | costBits);
+                }
+            }
+        }
+        chunkHashes[chunkIndex] = hash;
+        });
+
+    std::uint64_t hash = mix(mix(0, static_cast<std::uint64_t>(m_layout.width)), static_cast<std::uint64_t>(m_layout.height));
+    for (std::uint64_t chunkHash : chunkHashes) {
+        hash = mix(hash, chunkHash);
+    }
+    return hash;
+}
+
+size_t MapSnapshot::GetBuiltChunkCount() const {
+    return std::count_if(m_chunks.begin(), m_chunks.end(), [](const std::shared_ptr<Chunk>& chunk) {
+        return chunk && chunk->built.load(std::memory_order_acquire);
+        });
+}
+
+size_t MapSnapshot::GetNodeBytes() const {
+    return sizeof(*this) + m_chunks.capacity() * sizeof(m_chunks[0]) + m_allocatedChunks * sizeof(Chunk);
+}
+
+size_t MapSnapshot::GetEdgeBytes() const {
+    size_t bytes = 0;
+    for (const std::shared_ptr<Chunk>& chunk : m_chunks) {
+        if (chunk && chunk->built.load(std::memory_order_acquire)) {
+            bytes += chunk->nodes.size() * sizeof(Node);
+        }
+    }
+    return bytes;
+}
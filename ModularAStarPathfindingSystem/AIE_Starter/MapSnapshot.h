@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Pathfinding.h"
+#include "GridLayout.h"
+
+namespace AIForGames {
+
+    class WorkerPool;
+
+    // Sets the walkability of one cell. Edits are applied in batches, each batch producing one new map version
+    struct TileEdit {
+        int x{ 0 }; // Cell column
+        int y{ 0 }; // Cell row
+        bool walkable{ false }; // New walkability of the cell
+    };
+
+    // MapSnapshot is one immutable version of a NodeMap's walkability and graph. Snapshots are
+    // shared through std::shared_ptr: a search holds on to the snapshot it started with, so it
+    // never sees a half-applied edit, and an old version is freed once its last reader lets go.
+    // Edits never modify a published snapshot. BeginEdits() starts the next version as a copy
+    // that shares every chunk, and each edit copies only the chunks it touches, once per version.
+    class MapSnapshot : public std::enable_shared_from_this<MapSnapshot>
+    {
+    public:
+        // Chunk holds one GridLayout::ChunkSize square block of cells. Chunks without any
+        // walkable cell are never allocated. A chunk's walkability never changes once it is
+        // published; its nodes and edges are built the first time one of them is looked up,
+        // so untouched parts of a large map cost only their walkability bits.
+        struct Chunk {
+            std::uint64_t walkableRows[GridLayout::ChunkSize]{}; // Bit x of entry y is set if the cell is walkable
+            std::uint16_t rowOffsets[GridLayout::ChunkSize]{}; // Nodes in earlier rows, i.e. the dense index of each row's first node
+            std::vector<Node> nodes; // One node per walkable cell, in row-major order (or one per cell, see cellSlots)
+            std::uint64_t version{ 0 }; // Version that created this copy. An unpublished version only changes chunks it created
+            bool cellSlots{ false }; // nodes holds a slot for every cell, indexed by cell, so edits never move nodes
+            std::atomic<bool> built{ false }; // Set once nodes and edges exist
+            std::mutex buildMutex; // Serialises the first build between threads
+        };
+
+        MapSnapshot() = default; // Empty map with no cells
+        MapSnapshot(const GridLayout& layout, std::uint64_t version); // Map with every cell a wall
+
+        // Builds a snapshot from a walkability callback, one row of chunks per task on the pool.
+        // isWalkable is called from several threads at once, so it must not modify shared state
+        static std::shared_ptr<MapSnapshot> Create(const GridLayout& layout, std::uint64_t version, const std::function<bool(int x, int y)>& isWalkable, WorkerPool& pool);
+        // Returns an unpublished copy of this version, numbered version, for SetWalkable() and
+        // SetEdgeCost() to change. It shares every chunk with this snapshot until an edit touches it
+        std::shared_ptr<MapSnapshot> BeginEdits(std::uint64_t version) const;
+        // Edits of an unpublished version. Each one updates the edited nodes and their neighbours'
+        // connections only, copying the chunks holding them the first time this version touches
+        // them, so its cost does not depend on the map size. Must not be called once the
+        // version is shared with other threads
+        bool SetWalkable(int x, int y, bool walkable); // New connections cost 1. False if (x, y) is off the map
+        bool SetEdgeCost(int x, int y, int toX, int toY, float cost); // Cost of the connection between two neighbours, both ways. False if there is none
+
+        std::uint64_t GetVersion() const { return m_version; } // Increases with every published edit
+        const GridLayout& GetLayout() const { return m_layout; } // Grid dimensions and handle encoding
+        float GetMinEdgeCost() const { return m_minEdgeCost; } // No connection costs less, so Manhattan distance times this is admissible
+        bool IsWalkable(int x, int y) const; // True if the cell at (x, y) holds a node
+        bool IsValidNode(NodeHandle node) const; // True if the handle names a walkable cell of this version
+        NodeHandle GetNode(int x, int y) const; // Node at (x, y), or InvalidNode if out of bounds or a wall
+        const Node& GetNodeData(NodeHandle node) const; // Connections of a valid node (builds its chunk on first use)
+        void BuildAllChunks(WorkerPool& pool) const; // Builds every chunk's nodes and edges up front, spread over the pool
+        // Hash of everything a search depends on: map size, walkability and connection costs. Equal
+        // for snapshots describing the same graph, whatever their versions. Builds every chunk
+        std::uint64_t ComputeContentHash(WorkerPool& pool) const;
+        size_t GetAllocatedChunkCount() const { return m_allocatedChunks; } // Chunks holding at least one walkable cell
+        size_t GetBuiltChunkCount() const; // Chunks whose nodes and edges have been created
+        size_t GetNodeBytes() const; // Chunk table plus walkability and indexing data of each stored chunk
+        size_t GetEdgeBytes() const; // Bytes of all built nodes (edges are held inline)
+
+    private:
+        GridLayout m_layout; // Grid dimensions and handle encoding
+        std::uint64_t m_version{ 0 }; // Version number assigned by the owning NodeMap
+        std::vector<std::shared_ptr<Chunk>> m_chunks; // Indexed by chunk; nullptr for chunks with no walkable cells
+        size_t m_allocatedChunks{ 0 }; // Chunks holding at least one walkable cell
+        float m_minEdgeCost{ 1.0f }; // Lowest cost ever given to a connection of this version or an earlier one
+
+        static void FinishChunk(Chunk& chunk); // Computes row offsets once walkability is known
+        Chunk* EditableChunk(int x, int y); // Chunk holding (x, y), copied for this version first if needed; nullptr off the map
+        void BuildEditableChunk(Chunk& chunk, size_t chunkIndex) const; // Builds an unbuilt editable chunk with a slot per cell
+        void RelinkNode(Chunk& chunk, int x, int y) const; // Recomputes a built node's connections from the current walkability
+        const Chunk& GetBuiltChunk(NodeHandle node) const; // Returns the node's chunk, building it first if needed
+        void BuildChunk(Chunk& chunk, size_t chunkIndex) const; // Creates the chunk's nodes and their edges
+    };
+}
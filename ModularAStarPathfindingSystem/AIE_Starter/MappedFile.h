@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AIForGames {
+
+    // MappedFile maps a whole file read-only into memory. Pages are read from disk on first
+    // access and shared with the operating system's file cache, so opening even a large file
+    // takes microseconds and data that is never touched is never read
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string& fileName); // Maps the file, replacing any mapped before; false (quietly) if it cannot be mapped
+        void Close(); // Unmaps the file
+        bool IsOpen() const { return m_data != nullptr; }
+        const std::uint8_t* GetData() const { return m_data; } // First byte of the file; page-aligned
+        size_t GetSize() const { return m_size; } // File size in bytes
+
+    private:
+        const std::uint8_t* m_data{ nullptr };
+        size_t m_size{ 0 };
+#ifdef _WIN32
+        void* m_file{ nullptr }; // File handle
+        void* m_mapping{ nullptr }; // File mapping handle
+#endif
+    };
+}
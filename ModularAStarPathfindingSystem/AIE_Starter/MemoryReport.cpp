@@ -0,0 +1,59 @@
+#include "MemoryReport.h"
+#include <cstdio>
+#include <array>
+#include "raylib.h"
+
+using namespace AIForGames;
+
+namespace {
+    // Formats a byte count with a readable unit, e.g. "12.5 KB"
+    void FormatBytes(char* buffer, size_t bufferSize, size_t bytes) {
+        if (bytes >= 1024 * 1024) {
+            snprintf(buffer, bufferSize, "%.2f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+        }
+        else if (bytes >= 1024) {
+            snprintf(buffer, bufferSize, "%.1f KB", static_cast<double>(bytes) / 1024.0);
+        }
+        else {
+            snprintf(buffer, bufferSize, "%zu B", bytes);
+        }
+    }
+
+    // Label and value of each line, in display order
+    struct ReportLine {
+        const char* label;
+        size_t bytes;
+    };
+
+    std::array<ReportLine, 8> GetLines(const MemoryReport& report) {
+        return { {
+            { "Nodes", report.nodeBytes },
+            { "Edges", report.edgeBytes },
+            { "Search scratch", report.searchScratchBytes },
+            { "Caches", report.cacheBytes },
+            { "Agent paths", report.agentPathBytes },
+            { "Total", report.Total() },
+            { "Last search peak", report.lastSearchPeakBytes },
+            { "Max search peak", report.maxSearchPeakBytes },
+        } };
+    }
+}
+
+void MemoryReport::Print(std::ostream& out) const {
+    char value[32];
+    for (const ReportLine& line : GetLines(*this)) {
+        FormatBytes(value, sizeof(value), line.bytes);
+        out << "[MEMORY] " << line.label << ": " << value << " (" << line.bytes << " bytes)\n";
+    }
+}
+
+void MemoryReport::Draw(int x, int y, int fontSize, Color color) const {
+    char value[32];
+    char text[96];
+    for (const ReportLine& line : GetLines(*this)) {
+        FormatBytes(value, sizeof(value), line.bytes);
+        snprintf(text, sizeof(text), "%s: %s", line.label, value);
+        DrawText(text, x, y, fontSize, color);
+        y += fontSize + 2;
+    }
+}
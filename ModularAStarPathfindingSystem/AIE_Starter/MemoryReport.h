@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <raylib.h>
+
+namespace AIForGames {
+
+    // MemoryReport is a snapshot of the memory used by pathfinding, in bytes.
+    // NodeMap::GetMemoryReport() fills in everything it owns; agent paths are added by the
+    // caller, since agents live outside the map (see PathAgent::GetMemoryUsage()).
+    struct MemoryReport {
+        size_t nodeBytes{ 0 }; // Node storage and walkability flags
+        size_t edgeBytes{ 0 }; // Connection arrays of all nodes
+        size_t searchScratchBytes{ 0 }; // Scratch reserved by the search contexts of all threads
+        size_t cacheBytes{ 0 }; // Path caches and precomputed search structures
+        size_t agentPathBytes{ 0 }; // Paths held by agents
+        size_t lastSearchPeakBytes{ 0 }; // Scratch high-water mark of the most recent search on any thread
+        size_t maxSearchPeakBytes{ 0 }; // Largest scratch high-water mark of any search so far
+
+        size_t Total() const { return nodeBytes + edgeBytes + searchScratchBytes + cacheBytes + agentPathBytes; } // Bytes currently in use
+        void Print(std::ostream& out) const; // Writes the report as console lines
+        void Draw(int x, int y, int fontSize, Color color) const; // Draws the report as a debug overlay
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+namespace AIForGames {
+
+    // MpscQueue is a lock-free queue with many producers and one consumer. Producers push
+    // onto an atomic list head with compare-and-swap, so a worker never waits for another
+    // worker or for the consumer. The consumer takes the whole list in one exchange and
+    // reverses it, so items come out in the order they were pushed.
+    //
+    // Push() may be called from any thread. ConsumeAll() must only be called from one thread
+    // at a time (for PathfindingService this is the main loop).
+    template <typename T>
+    class MpscQueue
+    {
+        struct Item {
+            T value;
+            Item* next{ nullptr };
+        };
+
+        std::atomic<Item*> m_head{ nullptr }; // Most recently pushed item
+
+    public:
+        MpscQueue() = default;
+        ~MpscQueue() { ConsumeAll([](T&) {}); } // Drops items never consumed
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        void Push(T value) // Adds an item; safe from any thread
+        {
+            Item* item = new Item{ std::move(value) };
+            item->next = m_head.load(std::memory_order_relaxed);
+            while (!m_head.compare_exchange_weak(item->next, item, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+
+        // Removes every item pushed so far and calls consume on each, oldest first. Items pushed
+        // while this runs are left for the next call. Returns how many were consumed
+        template <typename Consumer>
+        size_t ConsumeAll(Consumer&& consume)
+        {
+            Item* newestFirst = m_head.exchange(nullptr, std::memory_order_acquire);
+
+            Item* oldestFirst = nullptr;
+            while (newestFirst) {
+                Item* next = newestFirst->next;
+                newestFirst->next = oldestFirst;
+                oldestFirst = newestFirst;
+                newestFirst = next;
+            }
+
+            size_t consumed = 0;
+            while (oldestFirst) {
+                Item* next = oldestFirst->next;
+                consume(oldestFirst->value);
+                delete oldestFirst;
+                oldestFirst = next;
+                consumed++;
+            }
+            return consumed;
+        }
+
+        bool IsEmpty() const { return m_head.load(std::memory_order_relaxed) == nullptr; } // Snapshot; may change straight away
+    };
+}
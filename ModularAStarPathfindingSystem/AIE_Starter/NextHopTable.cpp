@@ -0,0 +1,227 @@
+#include "NextHopTable.h"
+#include "MapSnapshot.h"
+#include "WorkerPool.h"
+#include "MappedFile.h"
+#include "BinaryImage.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+using namespace AIForGames;
+
+namespace {
+    // A connection in dense indices, plus the slot of the opposite connection in the target's list
+    struct DenseEdge {
+        std::uint32_t target;
+        float cost;
+        std::uint8_t backSlot;
+    };
+
+    // Per-worker scratch of the row searches
+    struct RowScratch {
+        std::vector<float> distance;
+        std::vector<std::uint32_t> queue; // FIFO for maps with a single edge cost
+        std::vector<std::pair<float, std::uint32_t>> heap; // Dijkstra open list otherwise
+    };
+}
+
+// The node count is not known until the map is scanned, so the scan is skipped when even one
+// node per allocated chunk would not fit
+std::shared_ptr<const NextHopTable> NextHopTable::Build(const MapSnapshot& snapshot, size_t budgetBytes, WorkerPool& pool) {
+    const GridLayout& layout = snapshot.GetLayout();
+    size_t maxNodes = static_cast<size_t>(std::sqrt(static_cast<double>(budgetBytes) * 4.0));
+    if (snapshot.GetAllocatedChunkCount() > maxNodes || layout.HandleCount() * sizeof(std::uint32_t) > budgetBytes) return nullptr;
+
+    std::vector<NodeHandle> nodes;
+    std::vector<std::uint32_t> indexOf(layout.HandleCount(), NoIndex);
+    for (int y = 0; y < layout.height; y++) {
+        for (int x = 0; x < layout.width; x++) {
+            NodeHandle node = snapshot.GetNode(x, y);
+            if (node == InvalidNode) continue;
+            if (nodes.size() == maxNodes) return nullptr;
+            indexOf[node] = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back(node);
+        }
+    }
+
+    const size_t nodeCount = nodes.size();
+    const size_t rowBytes = (nodeCount + 3) / 4;
+    if (sizeof(Header) + nodeCount * 2 * sizeof(std::uint32_t) + indexOf.size() * sizeof(std::uint32_t) + nodeCount * rowBytes > budgetBytes) return nullptr;
+
+    // Dense adjacency, only needed while building
+    std::vector<DenseEdge> edges(nodeCount * EdgeList::Capacity);
+    std::vector<std::uint8_t> edgeCounts(nodeCount);
+    bool uniformCost = true;
+    float firstCost = -1.0f;
+    for (std::uint32_t index = 0; index < nodeCount; index++) {
+        const EdgeList& connections = snapshot.GetNodeData(nodes[index]).connections;
+        for (const Edge& connection : connections) {
+            const EdgeList& back = snapshot.GetNodeData(connection.target).connections;
+            std::uint8_t backSlot = static_cast<std::uint8_t>(std::find_if(back.begin(), back.end(),
+                [&](const Edge& edge) { return edge.target == nodes[index]; }) - back.begin());
+            edges[index * EdgeList::Capacity + edgeCounts[index]++] = { indexOf[connection.target], connection.cost, backSlot };
+            firstCost = firstCost < 0.0f ? connection.cost : firstCost;
+            uniformCost = uniformCost && connection.cost == firstCost;
+        }
+    }
+
+    // Connected components, so unreachable pairs need no value of their own
+    std::vector<std::uint32_t> component(nodeCount, NoIndex);
+    std::vector<std::uint32_t> stack;
+    for (std::uint32_t root = 0; root < nodeCount; root++) {
+        if (component[root] != NoIndex) continue;
+        component[root] = root;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            std::uint32_t current = stack.back();
+            stack.pop_back();
+            for (std::uint8_t slot = 0; slot < edgeCounts[current]; slot++) {
+                std::uint32_t target = edges[current * EdgeList::Capacity + slot].target;
+                if (component[target] != NoIndex) continue;
+                component[target] = root;
+                stack.push_back(target);
+            }
+        }
+    }
+
+    // One shortest path tree per target, grown outwards from it. Reaching a node from its
+    // parent fixes the node's first move: back along the same connection
+    std::vector<std::uint8_t> moves(nodeCount * rowBytes, 0);
+    std::vector<RowScratch> scratch(pool.GetWorkerCount());
+    pool.ParallelFor(nodeCount, [&](size_t goal, unsigned int worker) {
+        RowScratch& rowScratch = scratch[worker];
+        std::vector<float>& distance = rowScratch.distance;
+        distance.assign(nodeCount, FLT_MAX);
+        std::uint8_t* row = moves.data() + goal * rowBytes;
+        auto reach = [&](std::uint32_t node, const DenseEdge& edge) {
+            row[node >> 2] = static_cast<std::uint8_t>((row[node >> 2] & ~(3 << ((node & 3) * 2))) | (edge.backSlot << ((node & 3) * 2)));
+            };
+
+        distance[goal] = 0.0f;
+        if (uniformCost) {
+            std::vector<std::uint32_t>& queue = rowScratch.queue;
+            queue.clear();
+            queue.push_back(static_cast<std::uint32_t>(goal));
+            for (size_t next = 0; next < queue.size(); next++) {
+                std::uint32_t current = queue[next];
+                for (std::uint8_t slot = 0; slot < edgeCounts[current]; slot++) {
+                    const DenseEdge& edge = edges[current * EdgeList::Capacity + slot];
+                    if (distance[edge.target] != FLT_MAX) continue;
+                    distance[edge.target] = distance[current] + edge.cost;
+                    reach(edge.target, edge);
+                    queue.push_back(edge.target);
+                }
+            }
+            return;
+        }
+
+        std::vector<std::pair<float, std::uint32_t>>& heap = rowScratch.heap;
+        heap.clear();
+        heap.emplace_back(0.0f, static_cast<std::uint32_t>(goal));
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            auto [currentDistance, current] = heap.back();
+            heap.pop_back();
+            if (currentDistance > distance[current]) continue; // Stale entry
+            for (std::uint8_t slot = 0; slot < edgeCounts[current]; slot++) {
+                const DenseEdge& edge = edges[current * EdgeList::Capacity + slot];
+                float tentative = currentDistance + edge.cost;
+                if (tentative >= distance[edge.target]) continue;
+                distance[edge.target] = tentative;
+                reach(edge.target, edge);
+                heap.emplace_back(tentative, edge.target);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
+        }
+        });
+
+    BinaryImageWriter writer;
+    Header header{ { 'N', 'H', 'T', '1' }, ImageFormat, 0, nodeCount, indexOf.size(), rowBytes };
+    writer.Append(header);
+    writer.AppendArray(std::span<const NodeHandle>(nodes));
+    writer.AppendArray(std::span<const std::uint32_t>(indexOf));
+    writer.AppendArray(std::span<const std::uint32_t>(component));
+    writer.AppendArray(std::span<const std::uint8_t>(moves));
+    std::shared_ptr<const std::vector<std::uint64_t>> image = writer.Finish();
+
+    std::shared_ptr<NextHopTable> table(new NextHopTable());
+    table->m_version = snapshot.GetVersion();
+    table->Attach(image, reinterpret_cast<const std::uint8_t*>(image->data()), image->size() * sizeof(std::uint64_t), header);
+    return table;
+}
+
+bool NextHopTable::Attach(std::shared_ptr<const void> storage, const std::uint8_t* image, size_t size, Header& header) {
+    BinaryImageReader reader(image, size);
+    if (!reader.Read(header) || std::memcmp(header.magic, "NHT1", sizeof(header.magic)) != 0 || header.format != ImageFormat || header.rowBytes != (header.nodeCount + 3) / 4
+        || !reader.ReadArray(m_nodes, header.nodeCount) || !reader.ReadArray(m_indexOf, header.handleCount)
+        || !reader.ReadArray(m_component, header.nodeCount) || !reader.ReadArray(m_moves, header.nodeCount * header.rowBytes)) {
+        return false;
+    }
+    m_storage = std::move(storage);
+    m_image = image;
+    m_imageSize = size;
+    m_rowBytes = static_cast<size_t>(header.rowBytes);
+    return true;
+}
+
+// The content hash stands in for checking the file against the map node by node, which would
+// cost as much as a large part of building it
+std::shared_ptr<const NextHopTable> NextHopTable::Load(const std::string& fileName, const MapSnapshot& snapshot, std::uint64_t mapHash) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(fileName)) return nullptr;
+
+    std::shared_ptr<NextHopTable> table(new NextHopTable());
+    table->m_version = snapshot.GetVersion();
+    Header header{};
+    bool attached = table->Attach(file, file->GetData(), file->GetSize(), header);
+    if (!attached && std::memcmp(header.magic, "NHT1", sizeof(header.magic)) == 0 && header.format != ImageFormat) {
+        std::cerr << "Error: Next-hop table '" << fileName << "' was saved in format " << header.format << ", not " << ImageFormat << "." << std::endl;
+        return nullptr;
+    }
+    if (!attached || header.mapHash != mapHash
+        || header.handleCount != snapshot.GetLayout().HandleCount()) {
+        std::cerr << "Error: Next-hop table '" << fileName << "' is damaged or was built for a different map." << std::endl;
+        return nullptr;
+    }
+    return table;
+}
+
+bool NextHopTable::Save(const std::string& fileName, std::uint64_t mapHash) const {
+    Header header;
+    std::memcpy(&header, m_image, sizeof(header));
+    header.mapHash = mapHash;
+    if (!SaveBinaryImage(fileName, m_image, m_imageSize, header)) {
+        std::cerr << "Error: Failed to write the next-hop table to '" << fileName << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t NextHopTable::GetMemoryUsage() const {
+    return sizeof(*this) + m_imageSize;
+}
+
+NodeHandle NextHopTable::GetNextHop(const MapSnapshot& snapshot, NodeHandle from, NodeHandle goal) const {
+    std::uint32_t fromIndex = IndexOf(from);
+    std::uint32_t goalIndex = IndexOf(goal);
+    if (fromIndex == NoIndex || goalIndex == NoIndex || fromIndex == goalIndex || m_component[fromIndex] != m_component[goalIndex]) return InvalidNode;
+    return snapshot.GetNodeData(from).connections[GetMove(fromIndex, goalIndex)].target;
+}
+
+SearchStatus NextHopTable::ExtractPath(const MapSnapshot& snapshot, NodeHandle start, NodeHandle goal, std::vector<NodeHandle>& outPath) const {
+    outPath.clear();
+    std::uint32_t startIndex = IndexOf(start);
+    std::uint32_t goalIndex = IndexOf(goal);
+    if (startIndex == NoIndex || goalIndex == NoIndex) return SearchStatus::InvalidEndpoints;
+    if (m_component[startIndex] != m_component[goalIndex]) return SearchStatus::NoPath;
+
+    outPath.push_back(start);
+    for (NodeHandle current = start; current != goal;) {
+        current = snapshot.GetNodeData(current).connections[GetMove(IndexOf(current), goalIndex)].target;
+        outPath.push_back(current);
+    }
+    return SearchStatus::Found;
+}
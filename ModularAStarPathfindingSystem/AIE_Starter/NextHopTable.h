@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "Pathfinding.h"
+
+namespace AIForGames {
+
+    class MapSnapshot;
+    class WorkerPool;
+
+    // NextHopTable holds the answer to every shortest path query on one map version: for each
+    // (source, target) pair, which of the source's connections to take first. A path is read
+    // out one hop at a time in O(path length), with no search. Connections are stored in an
+    // EdgeList of at most four, so each entry is two bits; pairs in different connected
+    // components are told apart by a component number per node instead of a fifth value.
+    //
+    // The table costs nodes^2 / 4 bytes, so NodeMap only builds it for maps that fit its budget
+    // (about 11,500 nodes in the default 32 MB). Rows are built in parallel, one Dijkstra search
+    // from each target. Relies on every connection being two-way with the same cost both ways.
+    // The data lives in a binary image (see BinaryImage.h), so a saved table is used straight
+    // from the memory-mapped file
+    class NextHopTable
+    {
+    public:
+        static constexpr size_t DefaultBudgetBytes = size_t(32) << 20; // Budget NodeMap uses unless told otherwise
+
+        // Builds the table for a fully built snapshot, or returns null if it would exceed budgetBytes
+        static std::shared_ptr<const NextHopTable> Build(const MapSnapshot& snapshot, size_t budgetBytes, WorkerPool& pool);
+        // Maps a table saved for a map with this content hash (see MapSnapshot::ComputeContentHash()).
+        // Null if the file is missing, damaged or for another map
+        static std::shared_ptr<const NextHopTable> Load(const std::string& fileName, const MapSnapshot& snapshot, std::uint64_t mapHash);
+        bool Save(const std::string& fileName, std::uint64_t mapHash) const; // Writes the table to a file; false on failure
+
+        std::uint64_t GetVersion() const { return m_version; } // Map version the table describes
+        size_t GetNodeCount() const { return m_nodes.size(); } // Walkable nodes covered
+        size_t GetMemoryUsage() const; // Bytes held by the table and its index (mapped from disk for loaded tables)
+        // Node after from on a shortest path to goal. InvalidNode if from is goal, either is not a
+        // node of this version, or goal cannot be reached. snapshot must be the version the table describes
+        NodeHandle GetNextHop(const MapSnapshot& snapshot, NodeHandle from, NodeHandle goal) const;
+        // Writes the whole path into outPath by following next hops
+        SearchStatus ExtractPath(const MapSnapshot& snapshot, NodeHandle start, NodeHandle goal, std::vector<NodeHandle>& outPath) const;
+
+    private:
+        static constexpr std::uint32_t NoIndex = 0xFFFFFFFFu; // m_indexOf value of cells that are not nodes
+
+        // Layout of the arrays in the image. Bumped whenever they or their encoding change, so
+        // files saved by an older build are rejected and rebuilt instead of being misread
+        static constexpr std::uint32_t ImageFormat = 1;
+
+        // Start of the image
+        struct Header {
+            char magic[4];
+            std::uint32_t format; // ImageFormat of the build that wrote it
+            std::uint64_t mapHash; // Content hash of the map; 0 until saved
+            std::uint64_t nodeCount;
+            std::uint64_t handleCount;
+            std::uint64_t rowBytes;
+        };
+
+        NextHopTable() = default;
+        // Points the table's arrays into an image kept alive by storage. False if the image is malformed
+        bool Attach(std::shared_ptr<const void> storage, const std::uint8_t* image, size_t size, Header& header);
+        std::uint32_t IndexOf(NodeHandle node) const { return node < m_indexOf.size() ? m_indexOf[node] : NoIndex; } // Dense index of a node
+        int GetMove(std::uint32_t from, std::uint32_t goal) const { return (m_moves[goal * m_rowBytes + (from >> 2)] >> ((from & 3) * 2)) & 3; } // Connection slot to take
+
+        std::uint64_t m_version{ 0 };
+        std::shared_ptr<const void> m_storage; // Owns the image: a buffer in memory or a MappedFile
+        const std::uint8_t* m_image{ nullptr }; // The whole image, for Save()
+        size_t m_imageSize{ 0 };
+        std::span<const NodeHandle> m_nodes; // Handle of each dense index
+        std::span<const std::uint32_t> m_indexOf; // Dense index of each handle, NoIndex for walls
+        std::span<const std::uint32_t> m_component; // Connected component of each dense index
+        size_t m_rowBytes{ 0 }; // Bytes per target row: four sources per byte
+        std::span<const std::uint8_t> m_moves; // Connection slot for each (target, source), one row per target
+    };
+}
@@ -1,86 +1,250 @@
 #include <glm/glm.hpp>
 #include "NodeMap.h"
 #include "Pathfinding.h"
+#include "SearchContext.h"
+#include "WorkerPool.h"
+#include "HashDistributedSearch.h"
+#include "PathfindingService.h"
+#include "NextHopTable.h"
+#include "CompressedPathDatabase.h"
 #include <iostream>
 #include <algorithm>
 #include <cfloat>
+#include <cstdlib>
+#include <climits>
+#include <cstdio>
+#include <filesystem>
 #include "raylib.h"
 
 using namespace AIForGames;
 
 // Constructor: Initialises the node map with default values
-NodeMap::NodeMap() : m_width(0), m_height(0), m_cellSize(0), m_nodes(nullptr) {}
+NodeMap::NodeMap() : m_cellSize(0), m_snapshot(std::make_shared<const MapSnapshot>()) {}
 
-// Destructor: Cleans up allocated memory for nodes
+// Background work posted by this map (table rebuilds, goal fields) refers to it, so it is
+// waited for before anything is torn down
 NodeMap::~NodeMap() {
-    if (m_nodes) {
-        for (int i = 0; i < m_width * m_height; i++) {
-            delete m_nodes[i]; // Delete each node
-        }
-        delete[] m_nodes; // Delete the array of pointers
-    }
+    WaitForBackgroundWork();
+}
+
+void NodeMap::WaitForBackgroundWork() {
+    WorkerPool::Shared().WaitForPosted();
 }
 
 // Initialises the node map using an ASCII representation
-void NodeMap::Initialise(std::vector<std::string> asciiMap, int cellSize) {
-    m_cellSize = static_cast<float>(cellSize); // Convert cell size to float
+void NodeMap::Initialise(const std::vector<std::string>& asciiMap, int cellSize, WorkerPool& pool) {
     const char emptySquare = '0'; // Empty square representation in ASCII map
 
     // Determine the map's dimensions
-    m_height = static_cast<int>(asciiMap.size());
-    m_width = static_cast<int>(asciiMap[0].size());
+    int height = static_cast<int>(asciiMap.size());
+    int width = static_cast<int>(asciiMap[0].size());
 
-    // Allocate memory for nodes
-    m_nodes = new Node * [m_width * m_height]();
-
-    // Loop through the ASCII map to create nodes
-    for (int y = 0; y < m_height; y++) {
-        std::string& line = asciiMap[y];
-        if (line.size() != static_cast<size_t>(m_width)) {
+    for (int y = 0; y < height; y++) {
+        const std::string& line = asciiMap[y];
+        if (line.size() != static_cast<size_t>(width)) {
             std::cout << "Mismatched line #" << y << " in ASCII map (" << line.size()
-                << " instead of " << m_width << ")" << std::endl;
+                << " instead of " << width << ")" << std::endl;
         }
+    }
 
-        for (int x = 0; x < m_width; x++) {
-            char tile = x < static_cast<int>(line.size()) ? line[x] : emptySquare;
-            if (tile != emptySquare) {
-                // Create a new node for non-empty tiles
-                m_nodes[x + m_width * y] = new Node(
-                    (static_cast<float>(x) + 0.5f) * m_cellSize,
-                    (static_cast<float>(y) + 0.5f) * m_cellSize
-                );
-            }
-        }
+    // Non-empty tiles hold a node. Small ASCII maps are built eagerly. Rows are only read,
+    // so the parallel build can parse them from any thread
+    Initialise(width, height, cellSize, [&](int x, int y) {
+        const std::string& line = asciiMap[y];
+        char tile = x < static_cast<int>(line.size()) ? line[x] : emptySquare;
+        return tile != emptySquare;
+        }, false, pool);
+}
+
+// Initialises the node map from a walkability callback. Handles are 32-bit, which limits each
+// side to GridLayout::MaxDimension cells; cell counts themselves are computed in 64 bits
+void NodeMap::Initialise(int width, int height, int cellSize, const std::function<bool(int x, int y)>& isWalkable, bool lazyBuild, WorkerPool& pool) {
+    m_cellSize = static_cast<float>(cellSize); // Convert cell size to float
+
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    m_pendingEdits.reset(); // Staged edits belong to the map being replaced
+    std::uint64_t version = m_snapshot.load()->GetVersion() + 1;
+    if (width <= 0 || height <= 0 || width > GridLayout::MaxDimension || height > GridLayout::MaxDimension) {
+        std::cerr << "Error: Map size " << width << "x" << height << " is not supported (each side must be 1 to "
+            << GridLayout::MaxDimension << " cells)." << std::endl;
+        m_layout = GridLayout();
+        m_snapshot.store(std::make_shared<const MapSnapshot>(m_layout, version));
+        return;
     }
 
-    // Establish connections between adjacent nodes
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            Node* node = GetNode(x, y);
-            if (node) {
-                // Connect to the west node
-                Node* nodeWest = x == 0 ? nullptr : GetNode(x - 1, y);
-                if (nodeWest) {
-                    node->ConnectTo(nodeWest, 1); // Default weight of 1
-                    nodeWest->ConnectTo(node, 1);
-                }
+    m_layout = GridLayout(width, height);
+    std::shared_ptr<const MapSnapshot> snapshot = MapSnapshot::Create(m_layout, version, isWalkable, pool);
+    if (!lazyBuild) {
+        snapshot->BuildAllChunks(pool);
+    }
+    std::shared_ptr<const NextHopTable> nextHops;
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase;
+    if (!lazyBuild) {
+        LoadPrecomputed(*snapshot, pool, nextHops, pathDatabase);
+    }
+    m_pathDatabase.store(std::move(pathDatabase), std::memory_order_release);
+    m_nextHops.store(std::move(nextHops), std::memory_order_release);
+    m_snapshot.store(std::move(snapshot), std::memory_order_release);
+    m_pathCache.InvalidateBefore(version);
+    m_subpathCache.InvalidateBefore(version);
+    m_goalFields.InvalidateBefore(version);
+}
 
-                // Connect to the south node
-                Node* nodeSouth = y == 0 ? nullptr : GetNode(x, y - 1);
-                if (nodeSouth) {
-                    node->ConnectTo(nodeSouth, 1);
-                    nodeSouth->ConnectTo(node, 1);
-                }
-            }
+// Without a precompute directory the next-hop table is simply built. With one, the map's
+// content hash names the files: structures saved for an identical map are mapped from disk,
+// and a table that had to be built is saved for next time. A path database file only exists
+// if one was built for this map before, so one that is rejected (damaged, or saved in an older
+// format) is rebuilt and replaced. Called with the edit lock held
+void NodeMap::LoadPrecomputed(const MapSnapshot& snapshot, WorkerPool& pool, std::shared_ptr<const NextHopTable>& outNextHops,
+    std::shared_ptr<const CompressedPathDatabase>& outPathDatabase) {
+    if (m_precomputeDirectory.empty()) {
+        outNextHops = m_nextHopBudget > 0 ? NextHopTable::Build(snapshot, m_nextHopBudget, pool) : nullptr;
+        return;
+    }
+
+    std::uint64_t mapHash = snapshot.ComputeContentHash(pool);
+    if (m_nextHopBudget > 0) {
+        std::string fileName = PrecomputeFileName(mapHash, ".nexthop");
+        outNextHops = NextHopTable::Load(fileName, snapshot, mapHash);
+        if (outNextHops && outNextHops->GetMemoryUsage() > m_nextHopBudget) {
+            outNextHops = nullptr;
+        }
+        else if (!outNextHops) {
+            outNextHops = NextHopTable::Build(snapshot, m_nextHopBudget, pool);
+            if (outNextHops) outNextHops->Save(fileName, mapHash);
+        }
+    }
+
+    std::string fileName = PrecomputeFileName(mapHash, ".cpd");
+    std::error_code error;
+    if (std::filesystem::exists(fileName, error)) {
+        outPathDatabase = CompressedPathDatabase::Load(fileName, snapshot, mapHash);
+        if (!outPathDatabase) {
+            std::shared_ptr<const CompressedPathDatabase> rebuilt = CompressedPathDatabase::Build(snapshot, pool);
+            rebuilt->Save(fileName, mapHash);
+            outPathDatabase = std::move(rebuilt);
         }
     }
 }
 
+std::string NodeMap::PrecomputeFileName(std::uint64_t mapHash, const char* extension) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(mapHash));
+    return (std::filesystem::path(m_precomputeDirectory) / (std::string(name) + extension)).string();
+}
+
+void NodeMap::SetPrecomputeDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    std::error_code error;
+    if (!directory.empty() && !std::filesystem::create_directories(directory, error) && error) {
+        std::cerr << "Error: Cannot create the precompute directory '" << directory << "' (" << error.message() << ")." << std::endl;
+        return;
+    }
+    m_precomputeDirectory = directory;
+}
+
+std::uint64_t NodeMap::GetContentHash() const {
+    return GetSnapshot()->ComputeContentHash(WorkerPool::Shared());
+}
+
+std::uint64_t NodeMap::ApplyEdits(const std::vector<TileEdit>& edits) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    MapSnapshot& next = PendingEdits();
+    for (const TileEdit& edit : edits) {
+        next.SetWalkable(edit.x, edit.y, edit.walkable);
+    }
+    return PublishPendingEdits();
+}
+
+bool NodeMap::SetWalkable(int x, int y, bool walkable) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return PendingEdits().SetWalkable(x, y, walkable);
+}
+
+bool NodeMap::SetEdgeCost(int x, int y, int toX, int toY, float cost) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return PendingEdits().SetEdgeCost(x, y, toX, toY, cost);
+}
+
+std::uint64_t NodeMap::PublishEdits() {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return m_pendingEdits ? PublishPendingEdits() : GetVersion();
+}
+
+// The pending version is private to the writer until it is published, so edits change it in
+// place. Starting it copies the chunk table once per version, not once per edit
+MapSnapshot& NodeMap::PendingEdits() {
+    if (!m_pendingEdits) {
+        std::shared_ptr<const MapSnapshot> current = m_snapshot.load(std::memory_order_acquire);
+        m_pendingEdits = current->BeginEdits(current->GetVersion() + 1);
+    }
+    return *m_pendingEdits;
+}
+
+// Publishes the edited version with a single atomic store. Readers that pinned the previous
+// version keep it alive until they finish
+std::uint64_t NodeMap::PublishPendingEdits() {
+    std::shared_ptr<const MapSnapshot> next = std::move(m_pendingEdits);
+    m_snapshot.store(next, std::memory_order_release);
+    m_pathCache.InvalidateBefore(next->GetVersion());
+    m_subpathCache.InvalidateBefore(next->GetVersion());
+    m_goalFields.InvalidateBefore(next->GetVersion());
+    // Searches fall back to A* until the table catches up with the new version, which is
+    // rebuilt off this thread. The path database takes far too long to rebuild, so it is dropped
+    m_pathDatabase.store(nullptr, std::memory_order_release);
+    if (m_nextHops.load(std::memory_order_acquire)) {
+        QueueNextHopRebuild();
+    }
+    return next->GetVersion();
+}
+
+// A queued rebuild builds whichever version is current when it starts, so a burst of edits
+// costs one rebuild. A table overtaken by another edit while it was being built is thrown
+// away (that edit queued the next rebuild), as is one for a map whose table has been disabled
+void NodeMap::QueueNextHopRebuild() {
+    if (m_nextHopRebuildQueued) return;
+    m_nextHopRebuildQueued = true;
+    WorkerPool::Shared().Post([this]() {
+        std::shared_ptr<const MapSnapshot> snapshot;
+        size_t budget;
+        {
+            std::lock_guard<std::mutex> lock(m_editMutex);
+            m_nextHopRebuildQueued = false;
+            snapshot = GetSnapshot();
+            budget = m_nextHopBudget;
+        }
+
+        std::shared_ptr<const NextHopTable> nextHops = NextHopTable::Build(*snapshot, budget, WorkerPool::Shared());
+        std::lock_guard<std::mutex> lock(m_editMutex);
+        if (snapshot->GetVersion() == GetVersion() && m_nextHops.load(std::memory_order_acquire)) {
+            m_nextHops.store(std::move(nextHops), std::memory_order_release);
+        }
+        });
+}
+
+// Returns true if the cell at (x, y) is on the map and walkable
+bool NodeMap::IsWalkable(int x, int y) const {
+    return GetSnapshot()->IsWalkable(x, y);
+}
+
 // Retrieves the node at the specified (x, y) grid position
-Node* NodeMap::GetNode(int x, int y) {
-    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
-        return nullptr; // Return nullptr if out of bounds
-    return m_nodes[x + m_width * y];
+NodeHandle NodeMap::GetNode(int x, int y) const {
+    return GetSnapshot()->GetNode(x, y);
+}
+
+// Returns the node for a handle in the current version. The editing thread is the only one
+// that can retire that version, so the reference stays valid for it until its next edit
+const Node& NodeMap::GetNodeData(NodeHandle node) const {
+    return GetSnapshot()->GetNodeData(node);
+}
+
+// Returns the world position of the centre of the node's cell
+glm::vec2 NodeMap::GetNodePosition(NodeHandle node) const {
+    glm::ivec2 coords = GetNodeCoords(node);
+    return glm::vec2(
+        (static_cast<float>(coords.x) + 0.5f) * m_cellSize,
+        (static_cast<float>(coords.y) + 0.5f) * m_cellSize
+    );
 }
 
 // Draws the node map and its connections
@@ -88,10 +252,11 @@ void NodeMap::Draw() {
     Color cellColor{ 255, 0, 0, 255 }; // Red for empty cells
     Color lineColor{ 128, 128, 128, 255 }; // Grey for connections
 
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            Node* node = GetNode(x, y);
-            if (node == nullptr) {
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot(); // One consistent version for the whole frame
+    for (int y = 0; y < m_layout.height; y++) {
+        for (int x = 0; x < m_layout.width; x++) {
+            NodeHandle node = snapshot->GetNode(x, y);
+            if (node == InvalidNode) {
                 // Draw a rectangle for empty cells
                 DrawRectangle(
                     static_cast<int>(x * m_cellSize),
@@ -103,13 +268,14 @@ void NodeMap::Draw() {
             }
             else {
                 // Draw lines to connected nodes
-                for (int i = 0; i < static_cast<int>(node->connections.size()); i++) {
-                    Node* other = node->connections[i].target;
+                glm::vec2 position = GetNodePosition(node);
+                for (const Edge& connection : snapshot->GetNodeData(node).connections) {
+                    glm::vec2 other = GetNodePosition(connection.target);
                     DrawLine(
-                        static_cast<int>(node->position.x),
-                        static_cast<int>(node->position.y),
-                        static_cast<int>(other->position.x),
-                        static_cast<int>(other->position.y),
+                        static_cast<int>(position.x),
+                        static_cast<int>(position.y),
+                        static_cast<int>(other.x),
+                        static_cast<int>(other.y),
                         lineColor
                     );
                 }
@@ -118,109 +284,401 @@ void NodeMap::Draw() {
     }
 }
 
+// Searches the current version. The snapshot is pinned for the whole search, so edits
+// published meanwhile cannot change the graph under it
+SearchStatus NodeMap::AStarSearch(NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath, const CancellationToken& cancel) {
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    return AStarSearch(*snapshot, startNode, endNode, outPath, cancel);
+}
+
+// Queries are independent, so each runs on whichever worker takes it, using that thread's
+// own SearchContext. Long searches are balanced by work stealing inside the pool
+void NodeMap::SearchBatch(std::span<const PathQuery> queries, std::span<PathResult> results) {
+    if (queries.size() != results.size()) {
+        std::cerr << "Error: SearchBatch needs one result per query (" << queries.size() << " queries, " << results.size() << " results)." << std::endl;
+        return;
+    }
+
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    WorkerPool::Shared().ParallelFor(queries.size(), [&](size_t index, unsigned int) {
+        PathResult& result = results[index];
+        result.status = AStarSearch(*snapshot, queries[index].start, queries[index].goal, result.path);
+        });
+}
+
 // A* Pathfinding algorithm implementation
-std::vector<Node*> NodeMap::AStarSearch(Node* startNode, Node* endNode) {
-    if (startNode == nullptr || endNode == nullptr) {
-        std::cerr << "Error: Start or End node is null." << std::endl;
-        return std::vector<Node*>();
+// Writes the path into outPath, reusing its capacity. All other temporaries come from the
+// calling thread's SearchContext, so steady-state queries do not touch the heap
+SearchStatus NodeMap::AStarSearch(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath, const CancellationToken& cancel) {
+    outPath.clear();
+    if (!snapshot.IsValidNode(startNode) || !snapshot.IsValidNode(endNode)) {
+        std::cerr << "Error: Start or End node is invalid." << std::endl;
+        return SearchStatus::InvalidEndpoints;
+    }
+
+    std::shared_ptr<const NextHopTable> nextHops = m_nextHops.load(std::memory_order_acquire);
+    if (nextHops && nextHops->GetVersion() == snapshot.GetVersion()) {
+        return nextHops->ExtractPath(snapshot, startNode, endNode, outPath);
+    }
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = m_pathDatabase.load(std::memory_order_acquire);
+    if (pathDatabase && pathDatabase->GetVersion() == snapshot.GetVersion()) {
+        return pathDatabase->ExtractPath(snapshot, startNode, endNode, outPath);
+    }
+    if (std::shared_ptr<const GoalDistanceField> goalField = m_goalFields.Acquire(snapshot, endNode)) {
+        return goalField->ExtractPath(snapshot, startNode, outPath);
     }
 
-    auto heuristic = [](Node* a, Node* b) {
-        // Heuristic: Squared Euclidean distance
-        glm::vec2 diff = b->position - a->position;
-        return glm::dot(diff, diff);
+    SearchStatus cachedStatus;
+    if (m_pathCache.Lookup(startNode, endNode, snapshot.GetVersion(), cachedStatus, outPath)) {
+        return cachedStatus;
+    }
+    if (m_subpathCache.FindSlice(startNode, endNode, snapshot.GetVersion(), outPath)) {
+        return SearchStatus::Found;
+    }
+
+    const GridLayout& layout = snapshot.GetLayout();
+    glm::ivec2 endCoords = layout.ToCoords(endNode);
+    float minEdgeCost = snapshot.GetMinEdgeCost();
+    auto heuristic = [&layout, endCoords, minEdgeCost](NodeHandle node) {
+        // Heuristic: Manhattan distance in cells times the cheapest edge cost. Every move is
+        // orthogonal and costs at least that, so this never overestimates and the returned path is optimal
+        glm::ivec2 diff = layout.ToCoords(node) - endCoords;
+        return static_cast<float>(std::abs(diff.x) + std::abs(diff.y)) * minEdgeCost;
         };
 
+    SearchContext& context = SearchContext::ForThisThread();
+    context.Begin(layout.ChunkCount());
+
     // Initialise start node
-    startNode->gScore = 0;
-    startNode->hScore = heuristic(startNode, endNode);
-    startNode->fScore = startNode->gScore + startNode->hScore;
-    startNode->previous = nullptr;
-
-    std::vector<Node*> openList;
-    std::vector<Node*> closedList;
-
-    openList.push_back(startNode);
-
-    while (!openList.empty()) {
-        // Sort open list by fScore
-        std::sort(openList.begin(), openList.end(), [](Node* a, Node* b) {
-            return a->fScore < b->fScore;
-            });
-
-        Node* currentNode = openList.front();
-        if (currentNode == endNode) break;
-
-        openList.erase(openList.begin());
-        closedList.push_back(currentNode);
-
-        for (Edge& connection : currentNode->connections) {
-            Node* targetNode = connection.target;
-            if (std::find(closedList.begin(), closedList.end(), targetNode) == closedList.end()) {
-                float tentative_gScore = currentNode->gScore + connection.cost;
-                float tentative_hScore = heuristic(targetNode, endNode);
-                float tentative_fScore = tentative_gScore + tentative_hScore;
-
-                if (std::find(openList.begin(), openList.end(), targetNode) == openList.end()) {
-                    targetNode->gScore = tentative_gScore;
-                    targetNode->hScore = tentative_hScore;
-                    targetNode->fScore = tentative_fScore;
-                    targetNode->previous = currentNode;
-                    openList.push_back(targetNode);
-                }
-                else if (tentative_fScore < targetNode->fScore) {
-                    targetNode->gScore = tentative_gScore;
-                    targetNode->hScore = tentative_hScore;
-                    targetNode->fScore = tentative_fScore;
-                    targetNode->previous = currentNode;
-                }
+    context.Open(startNode, 0.0f, heuristic(startNode), InvalidNode);
+
+    // Seed the open list with a stored optimal path heading from the start towards the goal.
+    // Their costs are exact, so the result stays optimal; with unit costs every seed has the
+    // start's fScore and the deepest one (highest gScore) is expanded first. outPath is the scratch
+    if (m_subpathCache.FindTail(startNode, endNode, snapshot.GetVersion(), layout, outPath)) {
+        float gScore = 0.0f;
+        for (size_t i = 1; i < outPath.size(); ++i) {
+            const EdgeList& connections = snapshot.GetNodeData(outPath[i - 1]).connections;
+            auto edge = std::find_if(connections.begin(), connections.end(), [&](const Edge& connection) { return connection.target == outPath[i]; });
+            if (edge == connections.end()) break;
+            gScore += edge->cost;
+            context.Open(outPath[i], gScore, gScore + heuristic(outPath[i]), outPath[i - 1]);
+        }
+        outPath.clear();
+    }
+
+    SearchStatus status = SearchStatus::NoPath;
+    unsigned int expansions = 0;
+    for (NodeHandle currentNode = context.PopOpen(); currentNode != InvalidNode; currentNode = context.PopOpen()) {
+        if (currentNode == endNode) {
+            status = SearchStatus::Found;
+            break;
+        }
+
+        // Polling a relaxed atomic every few hundred expansions keeps the check off the profile
+        // while still stopping a superseded search within microseconds
+        if ((++expansions & (CancelCheckInterval - 1)) == 0 && cancel.IsCancelled()) {
+            status = SearchStatus::Cancelled;
+            break;
+        }
+
+        float currentGScore = context.GetGScore(currentNode);
+        for (const Edge& connection : snapshot.GetNodeData(currentNode).connections) {
+            NodeHandle targetNode = connection.target;
+            if (context.IsClosed(targetNode)) continue;
+
+            float tentative_gScore = currentGScore + connection.cost;
+            if (tentative_gScore < context.GetGScore(targetNode)) {
+                context.Open(targetNode, tentative_gScore, tentative_gScore + heuristic(targetNode), currentNode);
             }
         }
     }
 
-    // Build the path by backtracking from the end node
-    std::vector<Node*> path;
-    Node* currentNode = endNode;
-    while (currentNode != nullptr) {
-        path.insert(path.begin(), currentNode);
-        currentNode = currentNode->previous;
+    if (status == SearchStatus::Found) {
+        // Build the path by backtracking from the end node. Appending and reversing once
+        // keeps this linear in the path length
+        for (NodeHandle currentNode = endNode; currentNode != InvalidNode; currentNode = context.GetPrevious(currentNode)) {
+            outPath.push_back(currentNode);
+        }
+        std::reverse(outPath.begin(), outPath.end());
+    }
+
+    context.RecordSearch(context.End() + outPath.size() * sizeof(NodeHandle), expansions);
+    m_pathCache.Insert(startNode, endNode, snapshot.GetVersion(), status, outPath, *this);
+    if (status == SearchStatus::Found) m_subpathCache.Insert(outPath, snapshot.GetVersion());
+    return status;
+}
+
+// Parallel single search. Its per-worker contexts are kept between calls, so repeated long
+// queries reuse their scratch like the serial search does
+SearchStatus NodeMap::AStarSearch(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath,
+    WorkerPool& pool, const CancellationToken& cancel) {
+    std::lock_guard<std::mutex> lock(m_parallelSearchMutex);
+    if (!m_parallelSearch) {
+        m_parallelSearch = std::make_unique<HashDistributedSearch>();
+    }
+
+    size_t peakBytes = 0;
+    size_t expansions = 0;
+    SearchStatus status = m_parallelSearch->Run(snapshot, startNode, endNode, outPath, pool, cancel, peakBytes, expansions);
+    SearchContext::ForThisThread().RecordSearch(peakBytes + outPath.size() * sizeof(NodeHandle), expansions);
+    return status;
+}
+
+// The pool is a PathfindingService owned by the map and started on first use, so every
+// asynchronous search shares its threads. Results are handed over on the worker that found
+// them rather than through DispatchCompleted(), as nobody dispatches this service
+PathFuture NodeMap::AStarSearchAsync(NodeHandle startNode, NodeHandle endNode, const CancellationToken& cancel) {
+    std::call_once(m_asyncServiceCreated, [this] { m_asyncService = std::make_unique<PathfindingService>(*this); });
+
+    std::shared_ptr<PathFuture::State> state = std::make_shared<PathFuture::State>();
+    PathRequestOptions options;
+    options.cancel = cancel;
+    options.completeOnWorker = true;
+    m_asyncService->Submit(startNode, endNode, options, [state](WaypointPath&& path) {
+        PathFuture::Fulfil(*state, std::move(path));
+        });
+    return PathFuture(state);
+}
+
+// Multi-start A*, run backwards from the goal. The heuristic is the Manhattan distance to the
+// nearest start. A minimum of consistent heuristics is itself consistent, so every node is
+// closed with its optimal cost and each start's path is optimal, not just the first one found.
+// The set of starts never shrinks during the search, which keeps the heuristic fixed
+SearchStatus NodeMap::AStarSearchToGoal(const MapSnapshot& snapshot, const std::vector<NodeHandle>& startNodes, NodeHandle endNode,
+    std::vector<std::vector<NodeHandle>>& outPaths, const CancellationToken& cancel) {
+    outPaths.resize(startNodes.size());
+    for (std::vector<NodeHandle>& path : outPaths) {
+        path.clear();
+    }
+    if (!snapshot.IsValidNode(endNode)) {
+        std::cerr << "Error: Start or End node is invalid." << std::endl;
+        return SearchStatus::InvalidEndpoints;
+    }
+
+    // Distinct walkable starts are the search's targets
+    const GridLayout& layout = snapshot.GetLayout();
+    std::vector<NodeHandle> targets;
+    for (NodeHandle start : startNodes) {
+        if (snapshot.IsValidNode(start) && std::find(targets.begin(), targets.end(), start) == targets.end()) {
+            targets.push_back(start);
+        }
     }
+    if (targets.empty()) {
+        std::cerr << "Error: Start or End node is invalid." << std::endl;
+        return SearchStatus::InvalidEndpoints;
+    }
+
+    std::vector<glm::ivec2> targetCoords;
+    for (NodeHandle target : targets) {
+        targetCoords.push_back(layout.ToCoords(target));
+    }
+    float minEdgeCost = snapshot.GetMinEdgeCost();
+    auto heuristic = [&layout, &targetCoords, minEdgeCost](NodeHandle node) {
+        glm::ivec2 coords = layout.ToCoords(node);
+        int nearest = INT_MAX;
+        for (const glm::ivec2& target : targetCoords) {
+            nearest = std::min(nearest, std::abs(coords.x - target.x) + std::abs(coords.y - target.y));
+        }
+        return static_cast<float>(nearest) * minEdgeCost;
+        };
+
+    SearchContext& context = SearchContext::ForThisThread();
+    context.Begin(layout.ChunkCount());
+    context.Open(endNode, 0.0f, heuristic(endNode), InvalidNode);
+
+    SearchStatus status = SearchStatus::NoPath;
+    size_t remaining = targets.size();
+    unsigned int expansions = 0;
+    for (NodeHandle currentNode = context.PopOpen(); currentNode != InvalidNode; currentNode = context.PopOpen()) {
+        if (std::find(targets.begin(), targets.end(), currentNode) != targets.end()) {
+            status = SearchStatus::Found;
+            if (--remaining == 0) break;
+        }
+
+        if ((++expansions & (CancelCheckInterval - 1)) == 0 && cancel.IsCancelled()) {
+            status = SearchStatus::Cancelled;
+            break;
+        }
+
+        float currentGScore = context.GetGScore(currentNode);
+        for (const Edge& connection : snapshot.GetNodeData(currentNode).connections) {
+            NodeHandle targetNode = connection.target;
+            if (context.IsClosed(targetNode)) continue;
+
+            float tentative_gScore = currentGScore + connection.cost;
+            if (tentative_gScore < context.GetGScore(targetNode)) {
+                context.Open(targetNode, tentative_gScore, tentative_gScore + heuristic(targetNode), currentNode);
+            }
+        }
+    }
+
+    // Predecessors point towards the goal, so walking them from a start already yields the
+    // path in travel order
+    size_t pathBytes = 0;
+    if (status != SearchStatus::Cancelled) {
+        for (size_t i = 0; i < startNodes.size(); i++) {
+            if (!snapshot.IsValidNode(startNodes[i]) || !context.IsClosed(startNodes[i])) continue;
+            for (NodeHandle currentNode = startNodes[i]; currentNode != InvalidNode; currentNode = context.GetPrevious(currentNode)) {
+                outPaths[i].push_back(currentNode);
+            }
+            pathBytes += outPaths[i].size() * sizeof(NodeHandle);
+        }
+    }
+
+    context.RecordSearch(context.End() + pathBytes, expansions);
+    return status;
+}
 
-    return path;
+// Convenience overload returning a new vector. Uses the thread's pooled path buffer as
+// scratch, so the only allocation is the returned path itself
+std::vector<NodeHandle> NodeMap::AStarSearch(NodeHandle startNode, NodeHandle endNode) {
+    std::vector<NodeHandle>& pathBuffer = SearchContext::ForThisThread().PathBuffer();
+    AStarSearch(startNode, endNode, pathBuffer);
+    return std::vector<NodeHandle>(pathBuffer.begin(), pathBuffer.end());
 }
 
 // Draws the calculated path on the screen
-void NodeMap::DrawPath(const std::vector<Node*>& path, Color lineColor) {
+void NodeMap::DrawPath(const std::vector<NodeHandle>& path, Color lineColor) {
     if (path.empty()) return;
 
     for (size_t i = 1; i < path.size(); i++) {
-        Node* nodeA = path[i - 1];
-        Node* nodeB = path[i];
+        NodeHandle nodeA = path[i - 1];
+        NodeHandle nodeB = path[i];
 
-        if (nodeA != nullptr && nodeB != nullptr) {
+        if (nodeA != InvalidNode && nodeB != InvalidNode) {
+            glm::vec2 positionA = GetNodePosition(nodeA);
+            glm::vec2 positionB = GetNodePosition(nodeB);
             DrawLine(
-                static_cast<int>(nodeA->position.x),
-                static_cast<int>(nodeA->position.y),
-                static_cast<int>(nodeB->position.x),
-                static_cast<int>(nodeB->position.y),
+                static_cast<int>(positionA.x),
+                static_cast<int>(positionA.y),
+                static_cast<int>(positionB.x),
+                static_cast<int>(positionB.y),
                 lineColor
             );
         }
     }
 }
 
+// Draws a compressed path. Each straight segment is a single line between waypoints
+void NodeMap::DrawPath(const WaypointPath& path, Color lineColor) {
+    for (size_t i = 1; i < path.WaypointCount(); i++) {
+        glm::vec2 positionA = GetNodePosition(path.GetWaypoint(i - 1));
+        glm::vec2 positionB = GetNodePosition(path.GetWaypoint(i));
+        DrawLine(
+            static_cast<int>(positionA.x),
+            static_cast<int>(positionA.y),
+            static_cast<int>(positionB.x),
+            static_cast<int>(positionB.y),
+            lineColor
+        );
+    }
+}
+
+// Reports the memory used by this map and by searches run on it. Agent paths are not
+// known to the map; callers add them from PathAgent::GetMemoryUsage()
+MemoryReport NodeMap::GetMemoryReport() const {
+    MemoryReport report;
+    // Only the current version is counted. Chunks it shares with older versions that are
+    // still pinned by searches are counted once; chunks only those versions hold are not
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    report.nodeBytes = sizeof(*this) + snapshot->GetNodeBytes();
+    report.edgeBytes = snapshot->GetEdgeBytes();
+    // Search statistics are kept per thread and only merged here
+    SearchStats searchStats = SearchContext::GetMergedStats();
+    report.searchScratchBytes = searchStats.reservedBytes;
+    report.lastSearchPeakBytes = searchStats.lastPeakBytes;
+    report.maxSearchPeakBytes = searchStats.maxPeakBytes;
+    report.cacheBytes = m_pathCache.GetMemoryUsage() + m_subpathCache.GetMemoryUsage() + m_goalFields.GetMemoryUsage();
+    if (std::shared_ptr<const NextHopTable> nextHops = m_nextHops.load(std::memory_order_acquire)) {
+        report.cacheBytes += nextHops->GetMemoryUsage();
+    }
+    if (std::shared_ptr<const CompressedPathDatabase> pathDatabase = m_pathDatabase.load(std::memory_order_acquire)) {
+        report.cacheBytes += pathDatabase->GetMemoryUsage();
+    }
+    return report;
+}
+
+void NodeMap::SetNextHopBudget(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    m_nextHopBudget = budgetBytes;
+    if (budgetBytes == 0) {
+        m_nextHops.store(nullptr, std::memory_order_release);
+    }
+}
+
+bool NodeMap::HasNextHops() const {
+    std::uint64_t version = GetVersion();
+    std::shared_ptr<const NextHopTable> nextHops = m_nextHops.load(std::memory_order_acquire);
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = m_pathDatabase.load(std::memory_order_acquire);
+    return (nextHops && nextHops->GetVersion() == version) || (pathDatabase && pathDatabase->GetVersion() == version);
+}
+
+// The snapshot is pinned before the table, so a table newer than it is never paired with it
+NodeHandle NodeMap::GetNextHop(NodeHandle from, NodeHandle goal) const {
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    std::shared_ptr<const NextHopTable> nextHops = m_nextHops.load(std::memory_order_acquire);
+    if (nextHops && nextHops->GetVersion() == snapshot->GetVersion()) {
+        return nextHops->GetNextHop(*snapshot, from, goal);
+    }
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = m_pathDatabase.load(std::memory_order_acquire);
+    if (pathDatabase && pathDatabase->GetVersion() == snapshot->GetVersion()) {
+        return pathDatabase->GetNextHop(*snapshot, from, goal);
+    }
+    return InvalidNode;
+}
+
+// Runs under the edit lock so the database is built for the version that is still current when it is published
+void NodeMap::BuildPathDatabase(WorkerPool& pool) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    snapshot->BuildAllChunks(pool);
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = CompressedPathDatabase::Build(*snapshot, pool);
+    if (!m_precomputeDirectory.empty()) {
+        std::uint64_t mapHash = snapshot->ComputeContentHash(pool);
+        pathDatabase->Save(PrecomputeFileName(mapHash, ".cpd"), mapHash);
+    }
+    m_pathDatabase.store(std::move(pathDatabase), std::memory_order_release);
+}
+
+bool NodeMap::SavePathDatabase(const std::string& fileName) const {
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = m_pathDatabase.load(std::memory_order_acquire);
+    if (!pathDatabase) {
+        std::cerr << "Error: There is no path database to save." << std::endl;
+        return false;
+    }
+    return pathDatabase->Save(fileName, GetContentHash());
+}
+
+bool NodeMap::LoadPathDatabase(const std::string& fileName) {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    std::shared_ptr<const MapSnapshot> snapshot = GetSnapshot();
+    std::shared_ptr<const CompressedPathDatabase> pathDatabase = CompressedPathDatabase::Load(fileName, *snapshot, snapshot->ComputeContentHash(WorkerPool::Shared()));
+    if (!pathDatabase) return false;
+    m_pathDatabase.store(std::move(pathDatabase), std::memory_order_release);
+    return true;
+}
+
+size_t NodeMap::GetAllocatedChunkCount() const {
+    return GetSnapshot()->GetAllocatedChunkCount();
+}
+
+size_t NodeMap::GetBuiltChunkCount() const {
+    return GetSnapshot()->GetBuiltChunkCount();
+}
+
 // Finds the closest node to a given world position
-Node* NodeMap::GetClosestNode(glm::vec2 worldPos) {
+NodeHandle NodeMap::GetClosestNode(glm::vec2 worldPos) {
     int i = static_cast<int>(worldPos.x / m_cellSize);
     int j = static_cast<int>(worldPos.y / m_cellSize);
 
-    if (i < 0 || i >= m_width || j < 0 || j >= m_height) {
+    if (worldPos.x < 0.0f || worldPos.y < 0.0f || !m_layout.Contains(i, j)) {
         std::cerr << "Error: Clicked position is out of bounds." << std::endl;
-        return nullptr;
+        return InvalidNode;
     }
 
-    Node* node = GetNode(i, j);
-    if (node == nullptr) {
+    NodeHandle node = GetNode(i, j);
+    if (node == InvalidNode) {
         std::cerr << "Error: Closest node is null. No valid node at this position." << std::endl;
     }
 
@@ -228,17 +686,44 @@ Node* NodeMap::GetClosestNode(glm::vec2 worldPos) {
 }
 
 namespace AIForGames {
-    Node* GetRandomValidNode(NodeMap& nodeMap, int width, int height)
+    NodeHandle GetRandomValidNode(const NodeMap& nodeMap)
     {
-        // Continuously selects a random grid position until it finds a valid node (i.e., one that exists and is walkable).
-        // Used by the Blue wanderer agent to find new destinations without crashing on invalid positions.
-        Node* node = nullptr;
-        while (node == nullptr)
-        {
-            int x = rand() % 12;
-            int y = rand() % 8;
-            node = nodeMap.GetNode(x, y);
+        // Picks random cells across the whole map until one is walkable. Used by the Blue wanderer
+        // agent to find new destinations without crashing on invalid positions. Random picks are
+        // bounded, so a mostly-walled map falls back to scanning from a random cell, and a map
+        // with no walkable cell at all returns InvalidNode instead of looping forever
+        std::shared_ptr<const MapSnapshot> snapshot = nodeMap.GetSnapshot();
+        int width = snapshot->GetLayout().width;
+        int height = snapshot->GetLayout().height;
+        long long cellCount = static_cast<long long>(width) * height;
+        if (cellCount <= 0) {
+            std::cerr << "Error: Cannot pick a random node from an empty map." << std::endl;
+            return InvalidNode;
         }
-        return node;
+
+        // rand() may stop at 32767, so it is scaled to the range rather than taken modulo it
+        auto randomBelow = [](long long count) {
+            return static_cast<long long>(rand()) * count / (static_cast<long long>(RAND_MAX) + 1);
+        };
+
+        const int maxAttempts = 64;
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            NodeHandle node = snapshot->GetNode(static_cast<int>(randomBelow(width)), static_cast<int>(randomBelow(height)));
+            if (node != InvalidNode) {
+                return node;
+            }
+        }
+
+        long long first = randomBelow(cellCount);
+        for (long long i = 0; i < cellCount; i++) {
+            long long cell = (first + i) % cellCount;
+            NodeHandle node = snapshot->GetNode(static_cast<int>(cell % width), static_cast<int>(cell / width));
+            if (node != InvalidNode) {
+                return node;
+            }
+        }
+
+        std::cerr << "Error: The map has no walkable node." << std::endl;
+        return InvalidNode;
     }
 }
@@ -3,26 +3,165 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <span>
 #include "Pathfinding.h"
+#include "GridLayout.h"
+#include "MapSnapshot.h"
+#include "CancellationToken.h"
+#include "WaypointPath.h"
+#include "MemoryReport.h"
+#include "WorkerPool.h"
+#include "PathFuture.h"
+#include "PathCache.h"
+#include "SubpathCache.h"
+#include "NextHopTable.h"
+#include "CompressedPathDatabase.h"
+#include "GoalFieldCache.h"
+#include <atomic>
 #include <raylib.h>
 
 namespace AIForGames {
 
+    class HashDistributedSearch;
+    class PathfindingService;
+
+    // NodeMap owns the current version of a grid map and the geometry used to draw it. The
+    // map data itself lives in immutable MapSnapshot versions, published RCU-style: readers pin
+    // the current snapshot with one atomic load and then use it without any further
+    // synchronisation, while edits build the next version beside it and PublishEdits() swaps it in.
+    // Neither side ever waits for the other. Searches always run against a single version.
     class NodeMap
     {
-        int m_width, m_height; // Dimensions of the grid (in cells)
+        GridLayout m_layout; // Grid dimensions and handle encoding (unchanged by edits)
         float m_cellSize; // Size of each cell in pixels
-        AIForGames::Node** m_nodes; // 2D array of node pointers (flattened)
+        std::atomic<std::shared_ptr<const MapSnapshot>> m_snapshot; // Current version; never null
+        std::mutex m_editMutex; // Serialises writers; readers never take it
+        std::shared_ptr<MapSnapshot> m_pendingEdits; // Next version while edits are staged for PublishEdits(); null when none are
+        PathCache m_pathCache; // Recent search results, disabled until SetPathCacheCapacity() is called
+        SubpathCache m_subpathCache; // Found paths indexed by node, disabled until SetSubpathCacheCapacity() is called
+        GoalFieldCache m_goalFields; // Distance fields of popular goals, disabled until SetGoalFieldBudget() is called
+        std::unique_ptr<HashDistributedSearch> m_parallelSearch; // Per-worker state of parallel single searches, created on first use
+        std::mutex m_parallelSearchMutex; // Runs one parallel single search at a time
+        std::atomic<std::shared_ptr<const NextHopTable>> m_nextHops; // All-pairs first moves, for maps within m_nextHopBudget; null otherwise
+        size_t m_nextHopBudget{ NextHopTable::DefaultBudgetBytes }; // Largest next-hop table built automatically
+        bool m_nextHopRebuildQueued{ false }; // A background rebuild of the table has been posted and not started yet. Guarded by m_editMutex
+        std::atomic<std::shared_ptr<const CompressedPathDatabase>> m_pathDatabase; // First moves for maps too large for the table; null unless built or loaded
+        std::string m_precomputeDirectory; // Where precomputed structures are saved by map content hash; empty for none
+        std::once_flag m_asyncServiceCreated; // Creates m_asyncService on the first asynchronous search
+        std::unique_ptr<PathfindingService> m_asyncService; // Workers behind AStarSearchAsync(); last, so it stops before the rest of the map goes away
+
+        // Loads or builds the precomputed structures for a new map. Called with m_editMutex held
+        void LoadPrecomputed(const MapSnapshot& snapshot, WorkerPool& pool, std::shared_ptr<const NextHopTable>& outNextHops,
+            std::shared_ptr<const CompressedPathDatabase>& outPathDatabase);
+        std::string PrecomputeFileName(std::uint64_t mapHash, const char* extension) const; // Cache file for a map hash
+        MapSnapshot& PendingEdits(); // Version being edited, started from the current one if needed. Called with m_editMutex held
+        std::uint64_t PublishPendingEdits(); // Swaps in the pending version and invalidates caches. Called with m_editMutex held
+        void QueueNextHopRebuild(); // Rebuilds the next-hop table for the current version in the background. Called with m_editMutex held
 
     public:
+        static constexpr unsigned int CancelCheckInterval = 256; // Node expansions between cancellation checks (a power of two)
+
         NodeMap(); // Constructor
-        ~NodeMap(); // Destructor
-        AIForGames::Node* GetNode(int x, int y); // Retrieves a node at specific coordinates (nullptr if out of bounds)
-        void Initialise(std::vector<std::string> asciiMap, int cellSize); // Builds the node map from an ASCII layout
+        ~NodeMap();
+        NodeHandle GetNode(int x, int y) const; // Retrieves the node at specific coordinates (InvalidNode if out of bounds or a wall)
+        bool IsWalkable(int x, int y) const; // True if the cell at (x, y) holds a node
+        // Connections of a valid node (builds its chunk on first use). The reference belongs to the
+        // current version and is only safe on the editing thread; other threads should pin a snapshot
+        const AIForGames::Node& GetNodeData(NodeHandle node) const;
+        glm::ivec2 GetNodeCoords(NodeHandle node) const { return m_layout.ToCoords(node); } // Grid coordinates of a node
+        glm::vec2 GetNodePosition(NodeHandle node) const; // World position of the centre of a node's cell
+        void Initialise(const std::vector<std::string>& asciiMap, int cellSize, WorkerPool& pool = WorkerPool::Shared()); // Builds the node map from an ASCII layout
+        // Builds a map of any size up to GridLayout::MaxDimension from a walkability callback.
+        // With lazyBuild, nodes and edges are only created for chunks that searches reach. The
+        // map is read and built in parallel on the pool, so isWalkable must be safe to call from
+        // several threads. Replaces the whole map, so it must not run while other threads are using it
+        void Initialise(int width, int height, int cellSize, const std::function<bool(int x, int y)>& isWalkable, bool lazyBuild, WorkerPool& pool = WorkerPool::Shared());
+        std::shared_ptr<const MapSnapshot> GetSnapshot() const { return m_snapshot.load(std::memory_order_acquire); } // Pins the current version
+        std::uint64_t GetVersion() const { return GetSnapshot()->GetVersion(); } // Number of the current version
+        // Applies a batch of walkability edits, along with any staged ones, as one new version and
+        // returns its number. Searches already running finish on the version they started with
+        std::uint64_t ApplyEdits(const std::vector<TileEdit>& edits);
+        // Runtime edits, staged in the next version until PublishEdits(). Each updates only the
+        // edited nodes and their neighbours' connections, so it takes constant time however
+        // large the map is; the chunks holding them are copied the first time a version touches
+        // them. A cell that becomes walkable connects at cost 1
+        bool SetWalkable(int x, int y, bool walkable); // False if (x, y) is off the map
+        bool SetEdgeCost(int x, int y, int toX, int toY, float cost); // Sets the cost both ways between neighbouring walkable cells; must be positive
+        // Publishes every staged edit as one new version, e.g. once per frame, and returns its
+        // number. Returns the current version if nothing is staged
+        std::uint64_t PublishEdits();
         void Draw(); // Renders the map including walls and node connections
-        std::vector<AIForGames::Node*> AStarSearch(AIForGames::Node* startNode, AIForGames::Node* endNode); // A* implementation
-        void DrawPath(const std::vector<AIForGames::Node*>& path, Color lineColor); // Draws a computed path visually
-        AIForGames::Node* GetClosestNode(glm::vec2 worldPos); // Gets the nearest node to a mouse click or agent position
+        std::vector<NodeHandle> AStarSearch(NodeHandle startNode, NodeHandle endNode); // A* implementation
+        // A* into a caller-owned buffer (no allocations once warmed up). The token is polled every
+        // CancelCheckInterval expansions; a cancelled search returns with an empty path
+        SearchStatus AStarSearch(NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath, const CancellationToken& cancel = CancellationToken());
+        SearchStatus AStarSearch(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath, const CancellationToken& cancel = CancellationToken()); // A* on a pinned version
+        // One A* query spread over every worker of the pool (see HashDistributedSearch). Finds a
+        // path as short as the serial search. Pays off for long cross-map queries; must not be
+        // called from a task running on the same pool
+        SearchStatus AStarSearch(const MapSnapshot& snapshot, NodeHandle startNode, NodeHandle endNode, std::vector<NodeHandle>& outPath,
+            WorkerPool& pool, const CancellationToken& cancel = CancellationToken());
+        // Enables the path cache in front of AStarSearch() with a bound in bytes; 0 disables it.
+        // Cached results are tied to the map version, so edits never serve stale paths
+        void SetPathCacheCapacity(size_t capacityBytes) { m_pathCache.SetCapacity(capacityBytes); }
+        PathCacheStats GetPathCacheStats() const { return m_pathCache.GetStats(); } // Hit rate, evictions and memory of the path cache
+        // Enables reuse of stored paths for queries that overlap them (see SubpathCache), with a
+        // bound in bytes; 0 disables it. Checked after the path cache, and also tied to the map version
+        void SetSubpathCacheCapacity(size_t capacityBytes) { m_subpathCache.SetCapacity(capacityBytes); }
+        SubpathCacheStats GetSubpathCacheStats() const { return m_subpathCache.GetStats(); } // Slices, seeded searches and memory of the subpath cache
+        // Counts queries per goal and keeps distance fields for the most popular goals within a bound in
+        // bytes (see GoalFieldCache); 0 disables it. Queries to a goal with a field need no search
+        void SetGoalFieldBudget(size_t budgetBytes) { m_goalFields.SetBudget(budgetBytes); }
+        void SetGoalFieldHotThreshold(unsigned int queries) { m_goalFields.SetHotThreshold(queries); } // Queries before a goal gets a field
+        GoalFieldStats GetGoalFieldStats() const { return m_goalFields.GetStats(); } // Hit rate, fields built and memory
+        std::vector<HotGoal> GetHotGoals(size_t count) const { return m_goalFields.GetHotGoals(count); } // Most queried goals, hottest first
+        // Maps whose next-hop table fits in this many bytes get one when built with Initialise()
+        // (without lazyBuild), and searches then read paths from it with no search. Each published
+        // edit queues a rebuild on the shared pool's background thread; until the table catches up,
+        // searches run A*. 0 discards the table; other values apply from the next Initialise()
+        void SetNextHopBudget(size_t budgetBytes);
+        void WaitForBackgroundWork(); // Blocks until table rebuilds and goal fields queued so far are in place
+        bool HasNextHops() const; // True if the current version has a next-hop table or a path database
+        // Node after from on a shortest path to goal, from the next-hop table or path database.
+        // InvalidNode if from is goal, the goal cannot be reached, or the current version has neither
+        NodeHandle GetNextHop(NodeHandle from, NodeHandle goal) const;
+        // Builds a compressed path database (see CompressedPathDatabase) for the current version on
+        // the pool, after which searches read paths from it. Takes time quadratic in the node count,
+        // so it is meant for static maps; edits discard it
+        void BuildPathDatabase(WorkerPool& pool = WorkerPool::Shared());
+        bool SavePathDatabase(const std::string& fileName) const; // Writes the path database to a file; false if there is none or writing failed
+        bool LoadPathDatabase(const std::string& fileName); // Reads a database saved for this map; false, keeping the current one, if the file does not match it
+        // Directory for precomputed structures, named by the map's content hash. From the next
+        // Initialise() (without lazyBuild), a next-hop table or path database saved there for an
+        // identical map is memory-mapped instead of built, and newly built ones are saved there.
+        // Empty turns this off
+        void SetPrecomputeDirectory(const std::string& directory);
+        std::uint64_t GetContentHash() const; // Hash of the current version's graph (see MapSnapshot::ComputeContentHash())
+        // Starts a search on this map's internal worker pool and returns at once. The future becomes
+        // ready when the search ends; cancelling the token abandons it
+        PathFuture AStarSearchAsync(NodeHandle startNode, NodeHandle endNode, const CancellationToken& cancel = CancellationToken());
+        // One reverse A* from endNode that finds optimal paths from every start at once. outPaths[i]
+        // receives the path from startNodes[i] to endNode, or stays empty if that start cannot reach it.
+        // Relies on every connection being two-way with the same cost in both directions
+        SearchStatus AStarSearchToGoal(const MapSnapshot& snapshot, const std::vector<NodeHandle>& startNodes, NodeHandle endNode,
+            std::vector<std::vector<NodeHandle>>& outPaths, const CancellationToken& cancel = CancellationToken());
+        // Answers every query on one pinned version, spread over all cores by the shared WorkerPool.
+        // results[i] receives the answer to queries[i]; both spans must be the same size
+        void SearchBatch(std::span<const PathQuery> queries, std::span<PathResult> results);
+        void DrawPath(const std::vector<NodeHandle>& path, Color lineColor); // Draws a computed path visually
+        void DrawPath(const WaypointPath& path, Color lineColor); // Draws a compressed path, one line per straight segment
+        NodeHandle GetClosestNode(glm::vec2 worldPos); // Gets the nearest node to a mouse click or agent position
+        MemoryReport GetMemoryReport() const; // Reports bytes used by nodes, edges, search scratch and caches
+        size_t GetAllocatedChunkCount() const; // Chunks holding at least one walkable cell
+        size_t GetBuiltChunkCount() const; // Chunks whose nodes and edges have been created
+        const GridLayout& GetLayout() const { return m_layout; } // Grid dimensions and handle encoding
+        int GetWidth() const { return m_layout.width; } // Grid width in cells
+        int GetHeight() const { return m_layout.height; } // Grid height in cells
+        float GetCellSize() const { return m_cellSize; } // Size of each cell in pixels
     };
-    Node* GetRandomValidNode(NodeMap& nodeMap, int width, int height); // Utility function that returns a random walkable node from the map
-}
\ No newline at end of file
+    NodeHandle GetRandomValidNode(const NodeMap& nodeMap); // Utility function that returns a random walkable node from the map (InvalidNode if it has none)
+}
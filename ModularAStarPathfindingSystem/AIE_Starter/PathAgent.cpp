@@ -1,22 +1,24 @@
 ﻿#include "NodeMap.h"
 #include "PathAgent.h"
+#include "SearchContext.h"
 #include "raylib.h"
 #include <algorithm>
+#include <utility>
 #include <cfloat>
 #include <iostream>
 
 using namespace AIForGames;
 
-void PathAgent::SetNode(AIForGames::Node* node)
+void PathAgent::SetNode(NodeHandle node)
 {
     // Sets the agent's current node and updates its position to the node's position.
-    if (node == nullptr) {
-        std::cerr << "Error: Attempted to set a null node." << std::endl;
+    if (node == InvalidNode) {
+        std::cerr << "Error: Attempted to set an invalid node." << std::endl;
         return;
     }
 
     m_currentNode = node;
-    m_position = node->position;
+    m_position = m_nodeMap->GetNodePosition(node);
 }
 
 void PathAgent::SetSpeed(float speed)
@@ -29,17 +31,24 @@ void PathAgent::SetSpeed(float speed)
 
 void PathAgent::Update(float deltaTime)
 {
+    if (m_hopGoal != InvalidNode) {
+        UpdateNextHop(deltaTime);
+        return;
+    }
+
     // If no path to follow, exit early
     if (m_path.empty()) return;
 
-    Node* nextNode = m_path[m_currentIndex];
-    if (nextNode == nullptr) {
-        std::cerr << "Error: Next node in the path is null." << std::endl;
+    // Waypoints are only stored where the route turns, so each step heads straight for the next turn
+    NodeHandle nextNode = m_path.GetWaypoint(m_currentIndex);
+    if (nextNode == InvalidNode) {
+        std::cerr << "Error: Next node in the path is invalid." << std::endl;
         return;
     }
+    glm::vec2 nextPosition = m_nodeMap->GetNodePosition(nextNode);
 
     // Compute direction and distance to the next node
-    glm::vec2 direction = nextNode->position - m_position;
+    glm::vec2 direction = nextPosition - m_position;
     float distance = glm::length(direction);
 
     glm::vec2 unitDirection = glm::normalize(direction);
@@ -51,28 +60,33 @@ void PathAgent::Update(float deltaTime)
     }
     else {
         // Arrived at (or overshot) the target node
-        m_position = nextNode->position;
+        m_position = nextPosition;
         m_currentIndex++;
 
-        if (m_currentIndex >= m_path.size()) {
-            if (m_targetNode != nullptr) {
+        if (m_currentIndex >= static_cast<int>(m_path.WaypointCount())) {
+            if (m_targetNode != InvalidNode) {
                 m_currentNode = m_targetNode;
-                m_targetNode = nullptr;
+                m_targetNode = InvalidNode;
             }
             m_path.clear();
+
+            // Last, as the resumed coroutine may give the agent a new path straight away
+            if (std::coroutine_handle<> waiter = std::exchange(m_arrivalWaiter, nullptr)) {
+                waiter.resume();
+            }
         }
         else {
             // Transition to next node in the path
-            m_position = nextNode->position;
+            m_position = nextPosition;
 
-            Node* newNextNode = m_path[m_currentIndex];
-            if (newNextNode == nullptr) {
-                std::cerr << "Error: New next node is null." << std::endl;
+            NodeHandle newNextNode = m_path.GetWaypoint(m_currentIndex);
+            if (newNextNode == InvalidNode) {
+                std::cerr << "Error: New next node is invalid." << std::endl;
                 return;
             }
 
             float overshootDistance = -distance;
-            glm::vec2 newDirection = newNextNode->position - nextNode->position;
+            glm::vec2 newDirection = m_nodeMap->GetNodePosition(newNextNode) - nextPosition;
             glm::vec2 newUnitDirection = glm::normalize(newDirection);
 
             m_position += newUnitDirection * overshootDistance;
@@ -80,19 +94,89 @@ void PathAgent::Update(float deltaTime)
     }
 }
 
-void PathAgent::GoToNode(AIForGames::Node* node, NodeMap& nodeMap, bool setEndNodeAsCurrent)
+void PathAgent::UpdateNextHop(float deltaTime)
+{
+    // Walks one hop at a time; the map is asked for the next node on arrival at each one
+    glm::vec2 nextPosition = m_nodeMap->GetNodePosition(m_nextHop);
+    glm::vec2 direction = nextPosition - m_position;
+    float distance = glm::length(direction);
+    float step = m_speed * deltaTime;
+    if (distance > step) {
+        m_position += direction / distance * step;
+        return;
+    }
+
+    m_position = nextPosition;
+    m_currentNode = m_nextHop;
+    if (m_currentNode != m_hopGoal) {
+        m_nextHop = m_nodeMap->GetNextHop(m_currentNode, m_hopGoal);
+        if (m_nextHop != InvalidNode) return;
+
+        // The table is rebuilt in the background after an edit and has no answer until it catches
+        // up, so the rest of the route is searched for and followed like any other path
+        NodeHandle goal = m_hopGoal;
+        NodeHandle origin = m_hopOrigin;
+        m_hopGoal = InvalidNode;
+        m_nextHop = InvalidNode;
+        SearchPath(goal, origin == InvalidNode);
+        if (origin != InvalidNode) {
+            m_currentNode = origin;
+        }
+        if (!m_path.empty()) return;
+        std::cerr << "Error: Lost the route to the destination. Check if the map was edited." << std::endl;
+    }
+    else if (m_hopOrigin != InvalidNode) {
+        m_currentNode = m_hopOrigin;
+    }
+    m_hopGoal = InvalidNode;
+    m_nextHop = InvalidNode;
+    m_path.clear();
+
+    // Last, as the resumed coroutine may give the agent a new path straight away
+    if (std::coroutine_handle<> waiter = std::exchange(m_arrivalWaiter, nullptr)) {
+        waiter.resume();
+    }
+}
+
+void PathAgent::GoToNode(NodeHandle node, bool setEndNodeAsCurrent)
 {
-    if (node == nullptr) {
-        std::cerr << "Error: Destination node is null." << std::endl;
+    if (node == InvalidNode) {
+        std::cerr << "Error: Destination node is invalid." << std::endl;
         return;
     }
 
-    m_path = nodeMap.AStarSearch(m_currentNode, node);
+    // A synchronous search replaces whatever was requested asynchronously
+    CancelPathRequest();
+    m_hopGoal = InvalidNode;
+
+    // Small maps answer every query from their next-hop table, so the agent asks for one node at
+    // a time. The route is still read out of the table once, so GetPath() can draw it. If the
+    // table has no answer, the path is searched for as on any other map
+    if (m_nodeMap->HasNextHops()) {
+        m_path.clear();
+        if (node == m_currentNode) return;
+        NodeHandle nextHop = m_nodeMap->GetNextHop(m_currentNode, node);
+        if (nextHop != InvalidNode) {
+            SearchPath(node, false);
+            m_nextHop = nextHop;
+            m_hopGoal = node;
+            m_hopOrigin = setEndNodeAsCurrent ? InvalidNode : m_currentNode;
+            return;
+        }
+    }
+
+    SearchPath(node, setEndNodeAsCurrent);
     if (m_path.empty()) {
         std::cerr << "Error: Path is empty. Check if start and end nodes are properly connected." << std::endl;
-        return;
     }
+}
 
+void PathAgent::SearchPath(NodeHandle node, bool setEndNodeAsCurrent)
+{
+    // Search into this thread's pooled buffer, then keep only the turning points
+    std::vector<NodeHandle>& fullPath = SearchContext::ForThisThread().PathBuffer();
+    m_nodeMap->AStarSearch(m_currentNode, node, fullPath);
+    m_path.Assign(fullPath, *m_nodeMap);
     m_currentIndex = 0;
 
     // If we want the final node to become the new "start" node once we reach it,
@@ -101,8 +185,64 @@ void PathAgent::GoToNode(AIForGames::Node* node, NodeMap& nodeMap, bool setEndNo
         m_targetNode = node;
     }
     else {
-        m_targetNode = nullptr;
+        m_targetNode = InvalidNode;
+    }
+}
+
+void PathAgent::SetPath(WaypointPath&& path, bool setEndNodeAsCurrent)
+{
+    // Adopts a path computed elsewhere (e.g. on a worker thread) without searching again
+    m_hopGoal = InvalidNode;
+    m_path = std::move(path);
+    m_currentIndex = 0;
+    m_targetNode = setEndNodeAsCurrent && !m_path.empty() ? m_path.Back() : InvalidNode;
+}
+
+PathTicket PathAgent::BeginPathRequest()
+{
+    // Each request gets a new ticket, so a slower, older result can never overwrite a newer one
+    m_awaitingPath = true;
+    return ++m_lastTicket;
+}
+
+bool PathAgent::SetPath(PathTicket ticket, WaypointPath&& path, bool setEndNodeAsCurrent)
+{
+    if (ticket != m_lastTicket) {
+        return false; // Superseded by a newer request
+    }
+
+    m_awaitingPath = false;
+    SetPath(std::move(path), setEndNodeAsCurrent);
+    return true;
+}
+
+PathRequestId PathAgent::RequestPath(PathfindingService& service, NodeHandle node, const PathRequestOptions& options, bool setEndNodeAsCurrent)
+{
+    if (node == InvalidNode) {
+        std::cerr << "Error: Destination node is invalid." << std::endl;
+        return 0;
     }
+
+    CancelPathRequest(); // The newer request supersedes the one in flight
+    PathRequestOptions requestOptions = options;
+    requestOptions.cancel = m_pendingRequest = CancellationToken::Create();
+
+    // The callback runs on the main thread during DispatchCompleted(); the ticket makes sure
+    // only the newest request's path is applied
+    PathTicket ticket = BeginPathRequest();
+    return service.Submit(m_currentNode, node, requestOptions, [this, ticket, setEndNodeAsCurrent](WaypointPath&& path) {
+        SetPath(ticket, std::move(path), setEndNodeAsCurrent);
+        });
+}
+
+void PathAgent::CancelPathRequest()
+{
+    // Stops the search on its worker. The ticket is also invalidated, in case the search
+    // finished just before the cancel and its path is already waiting to be dispatched
+    m_pendingRequest.Cancel();
+    m_pendingRequest = CancellationToken();
+    m_lastTicket++;
+    m_awaitingPath = false;
 }
 
     void PathAgent::Draw(Color color) const
@@ -7,27 +7,82 @@
 #include "raylib.h"
 #include "Pathfinding.h"
 #include "NodeMap.h"
+#include "WaypointPath.h"
+#include "PathfindingService.h"
 #include <cfloat>
+#include <coroutine>
 
 namespace AIForGames {
 
+    // Identifies one path request made on behalf of an agent. Only the most recent ticket is accepted
+    using PathTicket = unsigned int;
+
     class PathAgent
     {
     private:
         glm::vec2 m_position{ 0.0f, 0.0f }; // Current position of the agent in world space
-        int m_currentIndex{ 0 }; // Current index in the path
-        AIForGames::Node* m_currentNode{ nullptr }; // Node the agent is currently sitting on
+        int m_currentIndex{ 0 }; // Index of the waypoint the agent is heading towards
+        NodeMap* m_nodeMap; // Map the agent moves on; resolves node handles to positions
+        NodeHandle m_currentNode{ InvalidNode }; // Node the agent is currently sitting on
         float m_speed{ 0.0f }; // Movement speed in pixels per second
-		Node* m_targetNode{ nullptr }; // Target node to reach
+		NodeHandle m_targetNode{ InvalidNode }; // Target node to reach
+        PathTicket m_lastTicket{ 0 }; // Most recent ticket handed out by BeginPathRequest
+        bool m_awaitingPath{ false }; // True while the most recent ticket has not been fulfilled
+        CancellationToken m_pendingRequest; // Cancels the request made by the last RequestPath() call
+        std::coroutine_handle<> m_arrivalWaiter; // Coroutine suspended in Arrival(), resumed when the path runs out
+        NodeHandle m_hopGoal{ InvalidNode }; // Destination while walking by next hops instead of a stored path
+        NodeHandle m_nextHop{ InvalidNode }; // Node the agent is walking to when following next hops
+        NodeHandle m_hopOrigin{ InvalidNode }; // Node the next-hop walk started from, restored on arrival unless the goal becomes current
+
+        void UpdateNextHop(float deltaTime); // Update() for walks that follow the map's next-hop table
+        void SearchPath(NodeHandle node, bool setEndNodeAsCurrent); // Stores the route from the current node to node in m_path
 
     public:
-        std::vector<AIForGames::Node*> m_path; // Active path the agent is following
+        // Awaitable returned by Arrival(). Completes at once if the agent has no path to follow
+        class ArrivalAwaiter
+        {
+            PathAgent& m_agent;
+            std::coroutine_handle<> m_waiting; // This awaiter's coroutine while it is suspended
+
+        public:
+            explicit ArrivalAwaiter(PathAgent& agent) : m_agent(agent) {}
+            ~ArrivalAwaiter() { if (m_waiting && m_agent.m_arrivalWaiter == m_waiting) m_agent.m_arrivalWaiter = nullptr; } // Forgets a destroyed coroutine
+            ArrivalAwaiter(const ArrivalAwaiter&) = delete;
+            ArrivalAwaiter& operator=(const ArrivalAwaiter&) = delete;
+
+            bool await_ready() const noexcept { return !m_agent.IsMoving(); }
+            void await_suspend(std::coroutine_handle<> waiting) { m_waiting = waiting; m_agent.m_arrivalWaiter = waiting; }
+            void await_resume() { m_waiting = nullptr; }
+        };
+
+        explicit PathAgent(NodeMap& nodeMap) : m_nodeMap(&nodeMap) {} // Binds the agent to the map it moves on
+        WaypointPath m_path; // Active path the agent is following (turning points only)
         void Update(float deltaTime); // Updates agent movement along its path
-		void GoToNode(AIForGames::Node* node, NodeMap& nodeMap, bool setEndNodeAsCurrent = false); // Sets a new target node and calculates the path to it
+		// Sets a new target node and calculates the path to it. On maps with a next-hop table the
+		// agent asks the map for the next node each time it reaches one, and falls back to a searched
+		// path if the table has no answer (e.g. while it is rebuilt after an edit)
+		void GoToNode(NodeHandle node, bool setEndNodeAsCurrent = false);
+        void SetPath(WaypointPath&& path, bool setEndNodeAsCurrent = false); // Takes ownership of an already computed path
+        PathTicket BeginPathRequest(); // Starts an asynchronous request; earlier tickets become stale
+        bool SetPath(PathTicket ticket, WaypointPath&& path, bool setEndNodeAsCurrent = false); // Moves in a path for a ticket (false if the ticket is stale)
+        bool IsAwaitingPath() const { return m_awaitingPath; } // True while a requested path has not arrived yet
+        // Queues a search from the current node on the service's workers. The path is applied when the
+        // service dispatches it. Any request still in flight is cancelled first, so a superseded
+        // search stops on its worker instead of running to completion. options.cancel is replaced
+        // by the agent's own token
+        PathRequestId RequestPath(PathfindingService& service, NodeHandle node, const PathRequestOptions& options, bool setEndNodeAsCurrent = false);
+        void CancelPathRequest(); // Aborts the request in flight, if any; its path will never be applied
+        const WaypointPath& GetPath() const { return m_path; } // Route the agent is following, also when walking by next hops
+        bool IsMoving() const { return !m_path.empty() || m_hopGoal != InvalidNode; } // True until the agent reaches the end of its route
+        // For coroutines: co_await agent.Arrival() resumes from Update() once the agent reaches the
+        // end of its path. One coroutine can wait on an agent at a time
+        ArrivalAwaiter Arrival() { return ArrivalAwaiter(*this); }
+        size_t GetMemoryUsage() const { return m_path.GetMemoryUsage(); } // Bytes held by the agent's path
         void Draw(Color color) const; // Draws the agent on screen
-        void SetNode(AIForGames::Node* node); // Sets the agent's current node and updates position
+        void SetNode(NodeHandle node); // Sets the agent's current node and updates position
         void SetSpeed(float speed); // Adjusts the movement speed
-		AIForGames::Node* GetCurrentNode() const { return m_currentNode; } // Returns the current node
+		NodeHandle GetCurrentNode() const { return m_currentNode; } // Returns the current node
+        glm::vec2 GetPosition() const { return m_position; } // Current position in world space
     };
 }
 
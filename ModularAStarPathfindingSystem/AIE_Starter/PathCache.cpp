@@ -0,0 +1,176 @@
+#include "PathCache.h"
+#include "NodeMap.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace AIForGames;
+
+PathCache::PathCache(size_t capacityBytes) {
+    SetCapacity(capacityBytes);
+}
+
+void PathCache::SetCapacity(size_t capacityBytes) {
+    m_shardCapacityBytes = capacityBytes / ShardCount;
+    for (Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        EvictToCapacity(shard);
+        if (capacityBytes == 0) ReleaseSpares(shard);
+    }
+}
+
+// A hit moves the entry to the front of its shard's list. The stored path is expanded into
+// outPath node by node, back to front if the query runs the other way
+bool PathCache::Lookup(NodeHandle start, NodeHandle goal, std::uint64_t version, SearchStatus& outStatus, std::vector<NodeHandle>& outPath) {
+    if (!IsEnabled()) return false;
+
+    Key key = MakeKey(start, goal, version);
+    Shard& shard = ShardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.stats.lookups++;
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) return false;
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    const Entry& entry = *found->second;
+    outStatus = entry.status;
+    outPath.assign(entry.path.begin(), entry.path.end());
+    if (entry.start != start) {
+        std::reverse(outPath.begin(), outPath.end());
+        shard.stats.reverseHits++;
+    }
+    shard.stats.hits++;
+    return true;
+}
+
+void PathCache::Insert(NodeHandle start, NodeHandle goal, std::uint64_t version, SearchStatus status, const std::vector<NodeHandle>& path, const NodeMap& nodeMap) {
+    if (!IsEnabled() || version < m_minVersion.load(std::memory_order_relaxed)) return;
+    if (status != SearchStatus::Found && status != SearchStatus::NoPath) return;
+
+    // Compress outside the lock, into a buffer each thread keeps
+    thread_local WaypointPath compressed;
+    compressed.Assign(path, nodeMap);
+    Key key = MakeKey(start, goal, version);
+
+    Shard& shard = ShardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.find(key) != shard.index.end()) return; // Another thread searched it first
+
+    // Every entry's buffer is grown to the largest path seen as soon as it is reused, so once the
+    // sizes of stored paths settle no entry reallocates again, however short its last path was.
+    // Spares are taken in the order they were freed, so all of them get grown early on. Only a
+    // brand new entry makes room for its index node to be kept once it is removed
+    if (shard.spareEntries.empty()) {
+        shard.entries.emplace_front();
+        shard.spareIndexNodes.reserve(shard.entries.size());
+    }
+    else {
+        shard.entries.splice(shard.entries.begin(), shard.spareEntries, shard.spareEntries.begin());
+    }
+    shard.largestPath = std::max(shard.largestPath, compressed.WaypointCount());
+    Entry& entry = shard.entries.front();
+    if (entry.path.GetWaypoints().capacity() < shard.largestPath) entry.path.Reserve(shard.largestPath);
+    entry.key = key;
+    entry.start = start;
+    entry.status = status;
+    entry.path = compressed;
+    entry.bytes = sizeof(Entry) + entry.path.GetMemoryUsage() + sizeof(std::list<Entry>::iterator) + sizeof(Key) + 4 * sizeof(void*);
+
+    if (shard.spareIndexNodes.empty()) {
+        shard.index.emplace(key, shard.entries.begin());
+    }
+    else {
+        Index::node_type node = std::move(shard.spareIndexNodes.back());
+        shard.spareIndexNodes.pop_back();
+        node.key() = key;
+        node.mapped() = shard.entries.begin();
+        shard.index.insert(std::move(node));
+    }
+    shard.bytes += entry.bytes;
+    shard.stats.insertions++;
+    EvictToCapacity(shard);
+}
+
+void PathCache::InvalidateBefore(std::uint64_t version) {
+    std::uint64_t minVersion = m_minVersion.load();
+    while (version > minVersion && !m_minVersion.compare_exchange_weak(minVersion, version)) {}
+
+    for (Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        RemoveIf(shard, true, version);
+    }
+}
+
+void PathCache::Clear() {
+    for (Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        RemoveIf(shard, false, UINT64_MAX);
+        ReleaseSpares(shard);
+    }
+}
+
+void PathCache::EvictToCapacity(Shard& shard) {
+    size_t capacity = m_shardCapacityBytes.load(std::memory_order_relaxed);
+    while (shard.bytes > capacity && !shard.entries.empty()) {
+        Recycle(shard, std::prev(shard.entries.end()));
+        shard.stats.evictions++;
+    }
+}
+
+void PathCache::RemoveIf(Shard& shard, bool invalidation, std::uint64_t beforeVersion) {
+    for (auto entry = shard.entries.begin(); entry != shard.entries.end();) {
+        auto next = std::next(entry);
+        if (entry->key.version < beforeVersion) {
+            Recycle(shard, entry);
+            shard.stats.invalidations += invalidation ? 1 : 0;
+        }
+        entry = next;
+    }
+}
+
+// Spares only come from entries the shard once held, so they never outnumber its busiest moment
+void PathCache::Recycle(Shard& shard, std::list<Entry>::iterator entry) {
+    shard.bytes -= entry->bytes;
+    shard.spareIndexNodes.push_back(shard.index.extract(entry->key));
+    shard.spareEntries.splice(shard.spareEntries.end(), shard.entries, entry);
+}
+
+void PathCache::ReleaseSpares(Shard& shard) {
+    shard.spareEntries.clear();
+    shard.spareIndexNodes.clear();
+    shard.spareIndexNodes.shrink_to_fit();
+    shard.largestPath = 0;
+}
+
+PathCacheStats PathCache::GetStats() const {
+    PathCacheStats merged;
+    for (const Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        merged.lookups += shard.stats.lookups;
+        merged.hits += shard.stats.hits;
+        merged.reverseHits += shard.stats.reverseHits;
+        merged.insertions += shard.stats.insertions;
+        merged.evictions += shard.stats.evictions;
+        merged.invalidations += shard.stats.invalidations;
+        merged.entries += shard.entries.size();
+        merged.bytes += shard.bytes;
+    }
+    return merged;
+}
+
+size_t PathCache::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        bytes += shard.bytes + shard.index.bucket_count() * sizeof(void*) + shard.spareIndexNodes.capacity() * sizeof(Index::node_type);
+        for (const Entry& spare : shard.spareEntries) {
+            bytes += sizeof(Entry) + spare.path.GetMemoryUsage() + 2 * sizeof(void*);
+        }
+    }
+    return bytes;
+}
+
+void PathCacheStats::Print(std::ostream& out) const {
+    out << "[PATH CACHE] " << hits << " of " << lookups << " lookups hit (" << HitRate() * 100.0 << "%, " << reverseHits
+        << " reversed), " << insertions << " inserted, " << evictions << " evicted, " << invalidations << " invalidated; "
+        << entries << " entries, " << bytes / 1024 << " KB\n";
+}
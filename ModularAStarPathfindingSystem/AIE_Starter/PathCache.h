@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "Pathfinding.h"
+#include "WaypointPath.h"
+
+namespace AIForGames {
+
+    class NodeMap;
+
+    // Counters of a PathCache, merged over its shards when read
+    struct PathCacheStats {
+        size_t lookups{ 0 }; // Queries checked against the cache
+        size_t hits{ 0 }; // Lookups answered from the cache, including reverseHits
+        size_t reverseHits{ 0 }; // Hits served by reversing the path of the opposite query
+        size_t insertions{ 0 }; // Results stored
+        size_t evictions{ 0 }; // Entries dropped to stay within the capacity
+        size_t invalidations{ 0 }; // Entries dropped because the map changed
+        size_t entries{ 0 }; // Entries currently held
+        size_t bytes{ 0 }; // Memory currently held by the entries
+
+        double HitRate() const { return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0; } // Share of lookups that were hits
+        void Print(std::ostream& out) const; // Writes the counters as one console line
+    };
+
+    // PathCache remembers the results of recent searches, so agents that keep repeating the same
+    // routes (patrols, trips between hotspots) skip the search. Entries are keyed by the unordered
+    // pair of end nodes plus the map version: a query from goal to start is answered by reversing
+    // the stored path, since connections are two-way with equal costs. Results of an older version
+    // are never returned, and InvalidateBefore() drops them as soon as a new version is published.
+    // Paths are stored compressed as WaypointPaths. The cache is bounded in bytes and evicts the
+    // least recently used entries first. It is split into shards with a lock each, so searches on
+    // different threads rarely wait for one another. Evicted and invalidated entries are kept,
+    // with their path buffers and hash table nodes, for the next insertions to reuse, so a
+    // cache that has filled up stores new results without allocating.
+    class PathCache
+    {
+    public:
+        static constexpr size_t ShardCount = 16; // Independently locked parts of the cache
+
+        explicit PathCache(size_t capacityBytes = 0); // 0 disables the cache
+        PathCache(const PathCache&) = delete;
+        PathCache& operator=(const PathCache&) = delete;
+
+        bool IsEnabled() const { return m_shardCapacityBytes > 0; } // False while the capacity is 0
+        void SetCapacity(size_t capacityBytes); // Changes the bound, evicting entries if needed; 0 disables and empties the cache
+        // Looks up the result of a search on the given version. On a hit, outStatus and outPath receive
+        // it (the path running from start to goal) and true is returned
+        bool Lookup(NodeHandle start, NodeHandle goal, std::uint64_t version, SearchStatus& outStatus, std::vector<NodeHandle>& outPath);
+        // Stores a Found or NoPath result. Results of versions older than the last InvalidateBefore() are ignored
+        void Insert(NodeHandle start, NodeHandle goal, std::uint64_t version, SearchStatus status, const std::vector<NodeHandle>& path, const NodeMap& nodeMap);
+        void InvalidateBefore(std::uint64_t version); // Drops every entry of an older version
+        void Clear(); // Drops every entry (not counted as invalidations)
+        PathCacheStats GetStats() const; // Counters of all shards
+        size_t GetMemoryUsage() const; // Bytes held by entries and the shards' hash tables
+
+    private:
+        // Unordered pair of end nodes and the version they were searched on
+        struct Key {
+            NodeHandle low;
+            NodeHandle high;
+            std::uint64_t version;
+            bool operator==(const Key& other) const { return low == other.low && high == other.high && version == other.version; }
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const { return static_cast<size_t>((std::uint64_t(key.low) << 32 | key.high) * 0x9E3779B97F4A7C15ull ^ key.version); }
+        };
+
+        struct Entry {
+            Key key;
+            NodeHandle start; // End node the stored path starts from
+            SearchStatus status;
+            WaypointPath path;
+            size_t bytes; // Memory charged to this entry
+        };
+
+        using Index = std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>;
+
+        // One independently locked LRU list, padded so shards do not share cache lines
+        struct alignas(64) Shard {
+            mutable std::mutex mutex;
+            std::list<Entry> entries; // Most recently used first
+            Index index;
+            std::list<Entry> spareEntries; // Removed entries, kept for their path buffers
+            std::vector<Index::node_type> spareIndexNodes; // Removed index nodes, reinserted under new keys
+            size_t largestPath{ 0 }; // Most waypoints of any path stored, to which reused buffers grow
+            size_t bytes{ 0 };
+            PathCacheStats stats; // Counters of this shard; entries and bytes are filled in when read
+        };
+
+        static Key MakeKey(NodeHandle start, NodeHandle goal, std::uint64_t version) { return Key{ std::min(start, goal), std::max(start, goal), version }; }
+        Shard& ShardFor(const Key& key) { return m_shards[KeyHash()(key) % ShardCount]; }
+        void EvictToCapacity(Shard& shard); // Drops least recently used entries until the shard fits. Called with its lock held
+        void RemoveIf(Shard& shard, bool invalidation, std::uint64_t beforeVersion); // Drops entries older than beforeVersion. Called with its lock held
+        static void Recycle(Shard& shard, std::list<Entry>::iterator entry); // Moves an entry and its index node to the spares. Called with its lock held
+        static void ReleaseSpares(Shard& shard); // Frees the spares. Called with its lock held
+
+        Shard m_shards[ShardCount];
+        std::atomic<size_t> m_shardCapacityBytes{ 0 }; // Bound of each shard
+        std::atomic<std::uint64_t> m_minVersion{ 0 }; // Oldest version still accepted by Insert()
+    };
+}
@@ -0,0 +1,71 @@
+#include "PathFuture.h"
+#include <iostream>
+
+using namespace AIForGames;
+
+bool PathFuture::IsReady() const {
+    return m_state && m_state->ready.load(std::memory_order_acquire);
+}
+
+// The check and the move happen under one lock, so of two threads taking at once only one
+// gets the path
+WaypointPath PathFuture::Take() {
+    if (!m_state) {
+        std::cerr << "Error: Path future has no search behind it." << std::endl;
+        return WaypointPath();
+    }
+
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    if (m_state->taken) {
+        std::cerr << "Error: Path future's result has already been taken." << std::endl;
+        return WaypointPath();
+    }
+    if (!m_state->ready.load(std::memory_order_relaxed)) {
+        std::cerr << "Error: Path future is not ready." << std::endl;
+        return WaypointPath();
+    }
+
+    m_state->ready.store(false, std::memory_order_relaxed);
+    m_state->taken = true;
+    return std::move(m_state->path);
+}
+
+// Either side may come second: the result arriving after Then() runs the continuation on the
+// worker, and Then() after the result runs it here. The continuation is always called
+// outside the lock, so it may start another search. A result that was already claimed, by
+// Take() or an earlier Then(), cannot reach a new continuation, so it is refused
+void PathFuture::Then(Continuation continuation) {
+    if (!m_state) {
+        std::cerr << "Error: Path future has no search behind it." << std::endl;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    if (m_state->taken) {
+        std::cerr << "Error: Path future's result has already been taken." << std::endl;
+        return;
+    }
+    m_state->taken = true;
+    if (!m_state->ready.load(std::memory_order_relaxed)) {
+        m_state->continuation = std::move(continuation);
+        return;
+    }
+
+    m_state->ready.store(false, std::memory_order_relaxed);
+    WaypointPath path = std::move(m_state->path);
+    lock.unlock();
+    continuation(std::move(path));
+}
+
+void PathFuture::Fulfil(State& state, WaypointPath&& path) {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (state.continuation) {
+        Continuation continuation = std::move(state.continuation);
+        lock.unlock();
+        continuation(std::move(path));
+        return;
+    }
+
+    state.path = std::move(path);
+    state.ready.store(true, std::memory_order_release);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "WaypointPath.h"
+
+namespace AIForGames {
+
+    // PathFuture is the result of NodeMap::AStarSearchAsync(): a path that is still being
+    // searched on a worker thread. The caller can check IsReady() without blocking and Take()
+    // the path once it is ready, or register a continuation with Then(). The path is empty if
+    // the goal cannot be reached. A future whose request is cancelled never becomes ready.
+    // Copies share one result, which only one of them can take.
+    class PathFuture
+    {
+    public:
+        using Continuation = std::function<void(WaypointPath&& path)>; // Receives the path once the search ends
+
+        PathFuture() = default; // Future with no search behind it; never ready
+        bool IsValid() const { return m_state != nullptr; } // True if a search is behind this future
+        bool IsReady() const; // True once the search has finished and the path has not been taken
+        WaypointPath Take(); // Moves the path out. Only valid once IsReady() is true; empty if another caller took it
+        // Calls continuation with the path when the search finishes: on the worker thread, or straight
+        // away on this thread if it already has. The path is handed over, so Take() is not needed.
+        // Reports an error, and never calls continuation, if the result has already been claimed
+        void Then(Continuation continuation);
+
+    private:
+        friend class NodeMap;
+
+        // Result shared between the future and the search that fulfils it
+        struct State {
+            std::mutex mutex; // Guards everything but ready
+            std::atomic<bool> ready{ false }; // Set once path holds the result
+            WaypointPath path;
+            Continuation continuation; // Registered by Then() before the result arrived
+            bool taken{ false }; // Set once Take() or Then() has claimed the result
+        };
+
+        explicit PathFuture(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+        static void Fulfil(State& state, WaypointPath&& path); // Called by the worker that finished the search
+
+        std::shared_ptr<State> m_state;
+    };
+}
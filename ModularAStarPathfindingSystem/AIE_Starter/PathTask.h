@@ -0,0 +1,48 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace AIForGames {
+
+    // PathTask is the return type of agent behaviours written as coroutines. The coroutine
+    // starts running as soon as it is called and runs on the main thread until its first
+    // co_await, for example on PathfindingService::Find() or PathAgent::Arrival(). It is then
+    // resumed by the frame loop (DispatchCompleted() or PathAgent::Update()) when that event
+    // happens. No thread or polling is needed per behaviour, so thousands can be alive at once.
+    //
+    // The task owns the coroutine: destroying or reassigning it destroys the coroutine wherever
+    // it is suspended, which cancels the path request it was waiting for.
+    class PathTask
+    {
+    public:
+        struct promise_type {
+            PathTask get_return_object() { return PathTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; } // Kept until the task is destroyed, so IsDone() stays valid
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        PathTask() = default; // Task with no coroutine
+        PathTask(PathTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+        PathTask& operator=(PathTask&& other) noexcept
+        {
+            if (this != &other) {
+                if (m_handle) m_handle.destroy();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+        ~PathTask() { if (m_handle) m_handle.destroy(); }
+        PathTask(const PathTask&) = delete;
+        PathTask& operator=(const PathTask&) = delete;
+
+        bool IsDone() const { return !m_handle || m_handle.done(); } // True if there is no coroutine or it has returned
+
+    private:
+        explicit PathTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        std::coroutine_handle<promise_type> m_handle; // Owned coroutine; null for an empty task
+    };
+}
@@ -1,7 +1,11 @@
 #include "Pathfinding.h"
 
-void AIForGames::Node::ConnectTo(Node* other, float cost)
+bool AIForGames::Node::ConnectTo(NodeHandle other, float cost)
 {
 	// Establishes a connection from this node to another node (other) with an associated cost
-	connections.push_back(Edge(other, cost));
+	if (connections.count == EdgeList::Capacity) {
+		return false;
+	}
+	connections.edges[connections.count++] = Edge(other, cost);
+	return true;
 }
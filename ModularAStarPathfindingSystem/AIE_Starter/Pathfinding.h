@@ -3,30 +3,67 @@
 #include <vector>
 #include <raylib.h>
 #include <cfloat>
+#include <cstdint>
 
 namespace AIForGames
 {
-    // Forward declaration for circular references
-    struct Node;
+    // NodeHandle identifies a node within its NodeMap. It is a 32-bit index rather than a pointer,
+    // so edges and paths are half the size, node storage can be relocated, and paths can be
+    // saved or shared without fixing up addresses. Use NodeMap to turn a handle into grid
+    // coordinates, a world position or the node's connections.
+    using NodeHandle = std::uint32_t;
+    constexpr NodeHandle InvalidNode = 0xFFFFFFFFu; // Handle value meaning "no node"
+
+    // Outcome of a path search
+    enum class SearchStatus : std::uint8_t {
+        Found, // A path was written to the output
+        NoPath, // The goal cannot be reached from the start
+        InvalidEndpoints, // The start or goal is not a walkable node
+        Cancelled // The search was abandoned through its CancellationToken
+    };
+
+    // One independent query of a batch search
+    struct PathQuery {
+        NodeHandle start{ InvalidNode };
+        NodeHandle goal{ InvalidNode };
+    };
+
+    // Answer to a PathQuery. The path keeps its capacity when the result is reused for another batch
+    struct PathResult {
+        SearchStatus status{ SearchStatus::NoPath };
+        std::vector<NodeHandle> path; // Nodes from start to goal; empty unless status is Found
+    };
 
     // Edge represents a connection from one node to another with an associated cost
     struct Edge {
-        Node* target; // Destination node of the edge
+        NodeHandle target; // Destination node of the edge
         float cost; // Travel cost
-        Edge() : target(nullptr), cost(0) {}
-        Edge(Node* _target, float _cost) : target(_target), cost(_cost) {}
+        Edge() : target(InvalidNode), cost(0) {}
+        Edge(NodeHandle _target, float _cost) : target(_target), cost(_cost) {}
+    };
+
+    // EdgeList stores a node's connections inline. Grid nodes connect to at most their four
+    // orthogonal neighbours, so a fixed array replaces a heap allocation per node
+    struct EdgeList {
+        static constexpr int Capacity = 4; // Maximum connections per node
+
+        Edge edges[Capacity];
+        std::uint8_t count{ 0 };
+
+        Edge* begin() { return edges; }
+        Edge* end() { return edges + count; }
+        const Edge* begin() const { return edges; }
+        const Edge* end() const { return edges + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const Edge& operator[](size_t index) const { return edges[index]; }
     };
 
     // Node represents a single walkable location on the map
+    // Position and grid coordinates are derived from the node's handle by NodeMap, and per-search
+    // scores live in SearchContext, so a node only stores its connections
     struct Node {
-        glm::vec2 position; // Position in world space
-        float hScore; // Heuristic cost (estimated cost to goal)
-        float fScore; // Total cost (g + h)
-        std::vector<Edge> connections; // Adjacent nodes and their travel costs
-        float gScore; // Cost from start node to this node
-        Node* previous; // Pointer to previous node in the path
-        Node() : position(0.0f, 0.0f), gScore(FLT_MAX), hScore(FLT_MAX), fScore(FLT_MAX), previous(nullptr) {} // Default constructor initialises scores to FLT_MAX (unvisited)
-        Node(float x, float y) : position(x, y), gScore(FLT_MAX), hScore(FLT_MAX), fScore(FLT_MAX), previous(nullptr) {} // Constructor with specific position
-        void ConnectTo(Node* other, float cost); // Adds a connection to another node with the given cost
+        EdgeList connections; // Adjacent nodes and their travel costs
+        bool ConnectTo(NodeHandle other, float cost); // Adds a connection to another node with the given cost (false if full)
     };
 }
@@ -0,0 +1,304 @@
+#include "PathfindingService.h"
+#include "NodeMap.h"
+#include "SearchContext.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace AIForGames;
+
+PathfindingService::PathfindingService(NodeMap& nodeMap, unsigned int workerCount, const PathCoalescingPolicy& policy)
+    : m_nodeMap(nodeMap), m_policy(policy) {
+    if (workerCount == 0) {
+        // hardware_concurrency() may report 0 when unknown; always keep at least one worker
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = std::max(1u, cores > 1 ? cores - 1 : 1u);
+    }
+
+    m_workers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&PathfindingService::WorkerLoop, this);
+    }
+}
+
+PathfindingService::~PathfindingService() {
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopping = true;
+        m_queue.clear();
+        m_jobsByKey.clear();
+    }
+    m_queueSignal.notify_all();
+
+    // Workers finish the search they are on, then see m_stopping and exit
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+PathRequestId PathfindingService::Submit(NodeHandle start, NodeHandle goal, const PathRequestOptions& options, Callback onComplete) {
+    PathRequestId id;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        id = m_nextId++;
+        m_stats.submitted++;
+        Subscriber subscriber{ id, options.priority, options.deadline, PathClock::now(), options.cancel, options.completeOnWorker, std::move(onComplete) };
+
+        // Join a search already queued or running for the same pair. A running search that polls
+        // its only subscriber's token could be aborted under the newcomer, so that one is skipped
+        auto found = m_policy.shareIdentical ? m_jobsByKey.find(JobKey(start, goal)) : m_jobsByKey.end();
+        if (found != m_jobsByKey.end() && !found->second->searchCancel.CanBeCancelled()) {
+            Job& job = *found->second;
+            job.subscribers.push_back(std::move(subscriber));
+            m_stats.sharedIdentical++;
+            if (!job.running) {
+                // The shared search is as urgent as its most urgent subscriber
+                job.options.priority = std::min(job.options.priority, options.priority);
+                job.options.deadline = std::min(job.options.deadline, options.deadline);
+                job.options.onScreen = job.options.onScreen || options.onScreen;
+                std::make_heap(m_queue.begin(), m_queue.end(), RunsAfter);
+            }
+            return id;
+        }
+
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->order = id;
+        job->start = start;
+        job->goal = goal;
+        job->options = options;
+        job->subscribers.push_back(std::move(subscriber));
+        if (m_policy.shareIdentical) {
+            m_jobsByKey[JobKey(start, goal)] = job;
+        }
+        m_queue.push_back(std::move(job));
+        std::push_heap(m_queue.begin(), m_queue.end(), RunsAfter);
+    }
+    m_queueSignal.notify_one();
+    return id;
+}
+
+void PathfindingService::SetCoalescingPolicy(const PathCoalescingPolicy& policy) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_policy = policy;
+}
+
+// Hands finished paths to their callbacks, in the order the searches finished. Runs on the main
+// thread, which is the only thread that touches agents, so callbacks need no synchronisation of
+// their own. Paths finishing while this runs are picked up next frame
+size_t PathfindingService::DispatchCompleted() {
+    return m_completed.ConsumeAll([](Completion& completion) {
+        if (completion.onComplete) {
+            completion.onComplete(std::move(completion.path));
+        }
+        });
+}
+
+size_t PathfindingService::GetPendingCount() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_queue.size() + m_running;
+}
+
+PathSchedulerStats PathfindingService::GetStats() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_stats;
+}
+
+// Priority class first, then visible agents, then the earliest deadline. Ties run in
+// submission order, so requests without a deadline are first-come, first-served
+bool PathfindingService::RunsAfter(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+    if (a->options.priority != b->options.priority) return a->options.priority > b->options.priority;
+    if (a->options.onScreen != b->options.onScreen) return !a->options.onScreen;
+    if (a->options.deadline != b->options.deadline) return a->options.deadline > b->options.deadline;
+    return a->order > b->order;
+}
+
+bool PathfindingService::AllCancelled(const Job& job) {
+    return std::all_of(job.subscribers.begin(), job.subscribers.end(), [](const Subscriber& subscriber) {
+        return subscriber.cancel.IsCancelled();
+        });
+}
+
+// Pulls queued jobs with the same goal and a nearby start out of the queue, so one reverse
+// search from the goal answers all of them. Called with m_queueMutex held
+void PathfindingService::TakeSameGoalJobs(std::vector<std::shared_ptr<Job>>& group) {
+    const Job& first = *group[0];
+    glm::ivec2 origin = m_nodeMap.GetNodeCoords(first.start);
+    bool taken = false;
+    for (size_t i = 0; i < m_queue.size() && group.size() < m_policy.maxGroupSize;) {
+        const Job& job = *m_queue[i];
+        glm::ivec2 coords = m_nodeMap.GetNodeCoords(job.start);
+        if (job.goal == first.goal && std::abs(coords.x - origin.x) + std::abs(coords.y - origin.y) <= m_policy.sameGoalRadius && !AllCancelled(job)) {
+            group.push_back(std::move(m_queue[i]));
+            m_queue[i] = std::move(m_queue.back());
+            m_queue.pop_back();
+            m_stats.sharedSameGoal++;
+            taken = true;
+        }
+        else {
+            i++;
+        }
+    }
+    if (taken) {
+        std::make_heap(m_queue.begin(), m_queue.end(), RunsAfter);
+    }
+}
+
+// Runs without m_queueMutex. Only fields the worker owns once a job is running are touched
+bool PathfindingService::RunSearch(std::vector<std::shared_ptr<Job>>& group) {
+    // Scratch for grouped searches, reused by this worker for its whole lifetime
+    thread_local std::vector<NodeHandle> starts;
+    thread_local std::vector<std::vector<NodeHandle>> groupPaths;
+
+    starts.clear();
+    for (const std::shared_ptr<Job>& job : group) {
+        if (job->status != SearchStatus::Cancelled) {
+            starts.push_back(job->start);
+        }
+    }
+    if (starts.empty()) return false;
+
+    std::shared_ptr<const MapSnapshot> snapshot = m_nodeMap.GetSnapshot();
+    if (starts.size() == 1) {
+        // The thread-local SearchContext and its pooled path buffer live as long as this worker,
+        // so they are warmed up by the first few searches and reused by every later one
+        std::vector<NodeHandle>& fullPath = SearchContext::ForThisThread().PathBuffer();
+        for (const std::shared_ptr<Job>& job : group) {
+            if (job->status == SearchStatus::Cancelled) continue;
+            job->status = m_nodeMap.AStarSearch(*snapshot, job->start, job->goal, fullPath, job->searchCancel);
+            job->path.Assign(fullPath, m_nodeMap);
+        }
+        return true;
+    }
+
+    m_nodeMap.AStarSearchToGoal(*snapshot, starts, group[0]->goal, groupPaths);
+    size_t index = 0;
+    for (const std::shared_ptr<Job>& job : group) {
+        if (job->status == SearchStatus::Cancelled) continue;
+        std::vector<NodeHandle>& path = groupPaths[index++];
+        job->status = path.empty() ? SearchStatus::NoPath : SearchStatus::Found;
+        job->path.Assign(path, m_nodeMap);
+    }
+    return true;
+}
+
+void PathfindingService::WorkerLoop() {
+    std::vector<std::shared_ptr<Job>> group;
+    std::vector<Completion> completions;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueSignal.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) return;
+
+            std::pop_heap(m_queue.begin(), m_queue.end(), RunsAfter);
+            group.push_back(std::move(m_queue.back()));
+            m_queue.pop_back();
+            if (m_policy.groupSameGoal && !AllCancelled(*group[0])) {
+                TakeSameGoalJobs(group);
+            }
+
+            // Decide under the lock which jobs still have a live subscriber; requests cancelled
+            // while queued are dropped without searching
+            for (const std::shared_ptr<Job>& job : group) {
+                job->running = true;
+                job->status = AllCancelled(*job) ? SearchStatus::Cancelled : SearchStatus::NoPath;
+            }
+            Job& first = *group[0];
+            if (group.size() == 1 && first.subscribers.size() == 1) {
+                first.searchCancel = first.subscribers[0].cancel;
+            }
+            m_running++;
+        }
+
+        bool searched = RunSearch(group);
+        PathClock::time_point finished = PathClock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_running--;
+            m_stats.searches += searched ? 1 : 0;
+
+            for (const std::shared_ptr<Job>& job : group) {
+                auto found = m_jobsByKey.find(JobKey(job->start, job->goal));
+                if (found != m_jobsByKey.end() && found->second == job) {
+                    m_jobsByKey.erase(found);
+                }
+
+                // Subscribers that joined while the search ran are answered as well
+                size_t firstCompletion = completions.size();
+                for (Subscriber& subscriber : job->subscribers) {
+                    size_t priority = static_cast<size_t>(subscriber.priority);
+                    if (job->status == SearchStatus::Cancelled || subscriber.cancel.IsCancelled()) {
+                        m_stats.cancelled[priority]++;
+                        continue;
+                    }
+                    double latencyMs = std::chrono::duration<double, std::milli>(finished - subscriber.submitted).count();
+                    m_stats.completed[priority]++;
+                    m_stats.deadlineMisses[priority] += finished > subscriber.deadline ? 1 : 0;
+                    m_stats.totalLatencyMs[priority] += latencyMs;
+                    m_stats.worstLatencyMs[priority] = std::max(m_stats.worstLatencyMs[priority], latencyMs);
+                    completions.push_back(Completion{ WaypointPath(), std::move(subscriber.onComplete), subscriber.completeOnWorker });
+                }
+                // Every subscriber but the last gets a copy; the job is done with its path, so the last takes it
+                for (size_t i = firstCompletion; i + 1 < completions.size(); i++) {
+                    completions[i].path = job->path;
+                }
+                if (completions.size() > firstCompletion) {
+                    completions.back().path = std::move(job->path);
+                }
+            }
+        }
+
+        // Published after the scheduler lock is released, so the main loop never waits on a worker
+        for (Completion& completion : completions) {
+            if (completion.onWorker) {
+                if (completion.onComplete) {
+                    completion.onComplete(std::move(completion.path));
+                }
+            }
+            else {
+                m_completed.Push(std::move(completion));
+            }
+        }
+        completions.clear();
+        group.clear();
+    }
+}
+
+PathAwaiter::PathAwaiter(PathfindingService& service, NodeHandle start, NodeHandle goal, const PathRequestOptions& options)
+    : m_service(service), m_start(start), m_goal(goal), m_options(options) {}
+
+// Runs when the coroutine is destroyed, including while it is still waiting for the path
+PathAwaiter::~PathAwaiter() {
+    if (m_waiting) {
+        m_options.cancel.Cancel();
+    }
+}
+
+// The callback runs inside DispatchCompleted(), so the coroutine resumes on the main thread. A
+// path already queued for dispatch when the request was cancelled is dropped here, since the
+// awaiter that would receive it may be gone
+void PathAwaiter::await_suspend(std::coroutine_handle<> waiting) {
+    if (!m_options.cancel.CanBeCancelled()) {
+        m_options.cancel = CancellationToken::Create();
+    }
+    m_waiting = true;
+    m_service.Submit(m_start, m_goal, m_options, [this, waiting, cancel = m_options.cancel](WaypointPath&& path) {
+        if (cancel.IsCancelled()) return;
+        m_path = std::move(path);
+        m_waiting = false;
+        waiting.resume();
+        });
+}
+
+void PathSchedulerStats::Print(std::ostream& out) const {
+    const char* names[PathPriorityCount] = { "Player", "Gameplay", "Background" };
+    for (size_t i = 0; i < PathPriorityCount; i++) {
+        double averageMs = completed[i] > 0 ? totalLatencyMs[i] / completed[i] : 0.0;
+        out << "[SCHEDULER] " << names[i] << ": " << completed[i] << " completed, " << deadlineMisses[i]
+            << " deadline misses, " << cancelled[i] << " cancelled, " << averageMs << " ms average latency, " << worstLatencyMs[i] << " ms worst\n";
+    }
+    out << "[COALESCING] " << (sharedIdentical + sharedSameGoal) << " of " << submitted << " requests shared a search ("
+        << CoalescingHitRate() * 100.0 << "% hit rate): " << sharedIdentical << " identical, " << sharedSameGoal
+        << " same goal; " << searches << " searches run\n";
+}
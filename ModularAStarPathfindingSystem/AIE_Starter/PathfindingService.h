@@ -0,0 +1,178 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Pathfinding.h"
+#include "WaypointPath.h"
+#include "CancellationToken.h"
+#include "MpscQueue.h"
+
+namespace AIForGames {
+
+    class NodeMap;
+
+    // Identifies a request submitted to a PathfindingService
+    using PathRequestId = std::uint64_t;
+    using PathClock = std::chrono::steady_clock; // Clock used for request deadlines and latency
+
+    // Priority class of a path request. Lower classes always run first
+    enum class PathPriority : std::uint8_t {
+        Player, // Direct responses to player input
+        Gameplay, // Agents whose movement affects gameplay right now
+        Background, // Ambient agents such as wanderers
+        Count
+    };
+    constexpr size_t PathPriorityCount = static_cast<size_t>(PathPriority::Count);
+
+    // Scheduling information carried by each request. Within a priority class, on-screen
+    // requests run before off-screen ones, then the earliest deadline first. A cancelled request
+    // is dropped if it is still queued, or abandoned mid-search, and its callback never runs
+    struct PathRequestOptions {
+        PathPriority priority{ PathPriority::Gameplay }; // Priority class
+        PathClock::time_point deadline{ PathClock::time_point::max() }; // When the path is needed by; max() means no deadline
+        bool onScreen{ true }; // True if the requesting agent is visible
+        CancellationToken cancel; // Cancels the request; the default token never does
+        bool completeOnWorker{ false }; // Runs the callback on the worker as soon as the search ends, instead of in DispatchCompleted()
+    };
+
+    class PathfindingService;
+
+    // Awaitable returned by PathfindingService::Find(). co_await submits the request and
+    // suspends the coroutine; DispatchCompleted() resumes it on the main thread with the path,
+    // which is empty if there is none. Destroying a coroutine suspended here cancels its request.
+    // A request cancelled through its own token never resumes the coroutine
+    class PathAwaiter
+    {
+    public:
+        PathAwaiter(PathfindingService& service, NodeHandle start, NodeHandle goal, const PathRequestOptions& options);
+        ~PathAwaiter();
+        PathAwaiter(const PathAwaiter&) = delete;
+        PathAwaiter& operator=(const PathAwaiter&) = delete;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> waiting); // Submits the request
+        WaypointPath await_resume() { return std::move(m_path); }
+
+    private:
+        PathfindingService& m_service;
+        NodeHandle m_start;
+        NodeHandle m_goal;
+        PathRequestOptions m_options; // Always holds a cancellable token once submitted
+        WaypointPath m_path; // Filled in just before the coroutine is resumed
+        bool m_waiting{ false }; // True between submitting and resuming
+    };
+
+    // Controls how the service merges requests that can share a search
+    struct PathCoalescingPolicy {
+        bool shareIdentical{ true }; // Requests for a (start, goal) pair already queued or running wait for that search
+        bool groupSameGoal{ false }; // A worker also takes queued requests for the same goal and answers them with one reverse search
+        int sameGoalRadius{ 8 }; // Grouped starts lie within this many cells (Manhattan) of the first request's start
+        size_t maxGroupSize{ 16 }; // Most searches answered by one reverse search
+    };
+
+    // Scheduling metrics per priority class. Latency runs from Submit() until the search finishes,
+    // and a request misses its deadline if its search finishes after it
+    struct PathSchedulerStats {
+        size_t completed[PathPriorityCount]{}; // Requests searched
+        size_t deadlineMisses[PathPriorityCount]{}; // Requests that finished after their deadline
+        size_t cancelled[PathPriorityCount]{}; // Requests dropped or abandoned through their token (not counted above)
+        double totalLatencyMs[PathPriorityCount]{}; // Sum of latencies, for the average
+        double worstLatencyMs[PathPriorityCount]{}; // Longest latency seen
+        size_t submitted{ 0 }; // Requests submitted in total
+        size_t searches{ 0 }; // Searches actually run (a grouped reverse search counts once)
+        size_t sharedIdentical{ 0 }; // Requests answered by an identical request's search
+        size_t sharedSameGoal{ 0 }; // Requests answered by another request's reverse search
+
+        double CoalescingHitRate() const { return submitted > 0 ? static_cast<double>(sharedIdentical + sharedSameGoal) / submitted : 0.0; } // Share of requests that needed no search of their own
+        void Print(std::ostream& out) const; // Writes one console line per priority class, plus coalescing
+    };
+
+    // PathfindingService runs A* searches on a fixed pool of worker threads, started once and
+    // reused for every request. Queued requests are scheduled by their PathRequestOptions rather
+    // than in arrival order, and requests that can share a search are coalesced according to the
+    // PathCoalescingPolicy. Callers submit (start, goal) pairs; workers push finished paths onto
+    // a lock-free queue, and the main loop drains it once per frame with DispatchCompleted(), so
+    // completion callbacks can touch agents and other game state without locking. Each worker keeps its own SearchContext and path
+    // buffer for its whole lifetime, so searches on a warm worker do not allocate scratch.
+    class PathfindingService
+    {
+    public:
+        using Callback = std::function<void(WaypointPath&& path)>; // Receives the finished path on the main thread
+
+        // Starts workerCount threads; 0 sizes the pool to the hardware, leaving one core for the main thread
+        explicit PathfindingService(NodeMap& nodeMap, unsigned int workerCount = 0, const PathCoalescingPolicy& policy = PathCoalescingPolicy());
+        ~PathfindingService(); // Stops the workers. Requests still queued are dropped without a callback
+        PathfindingService(const PathfindingService&) = delete;
+        PathfindingService& operator=(const PathfindingService&) = delete;
+
+        PathRequestId Submit(NodeHandle start, NodeHandle goal, const PathRequestOptions& options, Callback onComplete); // Queues a search; never blocks on a running one
+        // For coroutines: auto path = co_await service.Find(start, goal); (see PathAwaiter)
+        PathAwaiter Find(NodeHandle start, NodeHandle goal, const PathRequestOptions& options = PathRequestOptions()) { return PathAwaiter(*this, start, goal, options); }
+        size_t DispatchCompleted(); // Runs the callbacks of finished requests; call once per frame. Returns how many ran
+        void SetCoalescingPolicy(const PathCoalescingPolicy& policy); // Applies to requests submitted or started from now on
+        size_t GetWorkerCount() const { return m_workers.size(); } // Number of worker threads
+        size_t GetPendingCount(); // Searches queued or running
+        PathSchedulerStats GetStats(); // Copy of the scheduling metrics so far
+
+    private:
+        // One caller waiting for a search
+        struct Subscriber {
+            PathRequestId id{ 0 };
+            PathPriority priority{ PathPriority::Gameplay };
+            PathClock::time_point deadline;
+            PathClock::time_point submitted;
+            CancellationToken cancel;
+            bool completeOnWorker{ false };
+            Callback onComplete;
+        };
+
+        // One (start, goal) search and everyone waiting for it. Its options are the most urgent of
+        // its subscribers', so a player request joining a background search pulls it forward
+        struct Job {
+            PathRequestId order{ 0 }; // Id of the first request, for first-come, first-served ties
+            NodeHandle start{ InvalidNode };
+            NodeHandle goal{ InvalidNode };
+            PathRequestOptions options;
+            std::vector<Subscriber> subscribers;
+            bool running{ false }; // Taken by a worker
+            CancellationToken searchCancel; // Token the running search polls: its only subscriber's, so nobody else may join
+            SearchStatus status{ SearchStatus::NoPath }; // Outcome, filled in by the worker
+            WaypointPath path; // Result, filled in by the worker
+        };
+
+        // A finished request on its way to the main thread
+        struct Completion {
+            WaypointPath path;
+            Callback onComplete;
+            bool onWorker{ false }; // Run by the worker rather than queued for the main thread
+        };
+
+        static bool RunsAfter(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b); // Heap order: true if a should be searched after b
+        static std::uint64_t JobKey(NodeHandle start, NodeHandle goal) { return (std::uint64_t(start) << 32) | goal; } // Key of m_jobsByKey
+        static bool AllCancelled(const Job& job); // True if no subscriber still wants the result
+        void TakeSameGoalJobs(std::vector<std::shared_ptr<Job>>& group); // Moves queued jobs that can share group[0]'s reverse search into group
+        bool RunSearch(std::vector<std::shared_ptr<Job>>& group); // Searches for every live job in group, outside the lock. False if none was live
+        void WorkerLoop(); // Body of each worker thread: takes requests until the service stops
+
+        NodeMap& m_nodeMap; // Map every request is searched on
+        std::vector<std::thread> m_workers; // Fixed pool, created in the constructor
+        std::mutex m_queueMutex; // Guards everything below except m_completed
+        std::condition_variable m_queueSignal; // Wakes idle workers when a request arrives or the service stops
+        std::vector<std::shared_ptr<Job>> m_queue; // Jobs waiting for a worker, as a heap ordered by RunsAfter
+        std::unordered_map<std::uint64_t, std::shared_ptr<Job>> m_jobsByKey; // Queued and running jobs, for sharing identical requests
+        PathCoalescingPolicy m_policy; // How requests are merged
+        size_t m_running{ 0 }; // Jobs currently being searched
+        bool m_stopping{ false }; // Set by the destructor to end the worker loops
+        PathRequestId m_nextId{ 1 }; // Id handed to the next submitted request
+        PathSchedulerStats m_stats; // Scheduling metrics, updated as searches finish
+        MpscQueue<Completion> m_completed; // Finished requests waiting for DispatchCompleted(); pushed by workers without locking
+    };
+}
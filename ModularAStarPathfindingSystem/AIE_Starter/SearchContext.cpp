@@ -0,0 +1,233 @@
+#include "SearchContext.h"
+#include <algorithm>
+#include <cfloat>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+using namespace AIForGames;
+
+namespace {
+    // Every live context, so statistics can be merged when they are read. Only touched when a
+    // context is created or destroyed and when statistics are read, never by a search
+    std::mutex s_registryMutex;
+    std::vector<const SearchContext*> s_liveContexts;
+    SearchStats s_retiredStats; // Totals of contexts already destroyed
+    std::int64_t s_retiredLastSearchTime = 0; // When the most recent search of a destroyed context ended
+
+    std::atomic<size_t> s_retentionLimit{ size_t(32) << 20 }; // Scratch each context keeps between queries
+}
+
+SearchContext::SearchContext() {
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    s_liveContexts.push_back(this);
+}
+
+SearchContext::~SearchContext() {
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    s_liveContexts.erase(std::find(s_liveContexts.begin(), s_liveContexts.end(), this));
+    s_retiredStats.searches += m_stats.searches.load(std::memory_order_relaxed);
+    s_retiredStats.expansions += m_stats.expansions.load(std::memory_order_relaxed);
+    s_retiredStats.maxPeakBytes = std::max(s_retiredStats.maxPeakBytes, m_stats.maxPeakBytes.load(std::memory_order_relaxed));
+    std::int64_t lastSearchTime = m_stats.lastSearchTime.load(std::memory_order_relaxed);
+    if (lastSearchTime > s_retiredLastSearchTime) {
+        s_retiredLastSearchTime = lastSearchTime;
+        s_retiredStats.lastPeakBytes = m_stats.lastPeakBytes.load(std::memory_order_relaxed);
+    }
+}
+
+// Prepares the context for a new query without releasing any memory
+void SearchContext::Begin(size_t chunkCount) {
+    m_openList.clear();
+    m_touchedRecords = 0;
+    m_peakOpenEntries = 0;
+
+    if (m_pages.size() < chunkCount) {
+        m_pages.resize(chunkCount);
+        m_pageGenerations.resize(chunkCount, 0);
+    }
+
+    // A new generation invalidates every record at once. On wrap-around, clear them for real
+    if (++m_generation == 0) {
+        for (std::unique_ptr<RecordPage>& page : m_pages) {
+            for (int i = 0; page && i < GridLayout::ChunkCells; i++) {
+                page->records[i].generation = 0;
+            }
+        }
+        std::fill(m_pageGenerations.begin(), m_pageGenerations.end(), 0);
+        m_generation = 1;
+    }
+
+    UpdateReservedBytes();
+}
+
+// Returns the node's record, resetting it first if it belongs to an earlier query
+SearchContext::NodeRecord& SearchContext::Record(NodeHandle node) {
+    std::unique_ptr<RecordPage>& page = m_pages[GridLayout::ChunkOf(node)];
+    if (!page) {
+        // First visit to this chunk by this thread. Generation 0 is never current, so the
+        // zeroed page starts out invalid
+        page = std::make_unique<RecordPage>();
+        m_allocatedPages++;
+    }
+
+    NodeRecord& record = page->records[GridLayout::LocalOf(node)];
+    if (record.generation != m_generation) {
+        record = NodeRecord{ FLT_MAX, InvalidNode, m_generation, false };
+        m_pageGenerations[GridLayout::ChunkOf(node)] = m_generation;
+        m_touchedRecords++;
+    }
+    return record;
+}
+
+const SearchContext::NodeRecord* SearchContext::FindRecord(NodeHandle node) const {
+    const std::unique_ptr<RecordPage>& page = m_pages[GridLayout::ChunkOf(node)];
+    if (!page) return nullptr;
+
+    const NodeRecord& record = page->records[GridLayout::LocalOf(node)];
+    return record.generation == m_generation ? &record : nullptr;
+}
+
+// Orders the heap so the entry with the lowest fScore is at the front. On equal fScore the
+// deeper node wins, which stops A* from widening across open areas where many nodes tie
+bool SearchContext::HeapOrder(const OpenEntry& a, const OpenEntry& b) {
+    if (a.fScore != b.fScore) return a.fScore > b.fScore;
+    return a.gScore < b.gScore;
+}
+
+// Records a better path to the node and pushes it onto the open list. Serial A* never
+// improves a closed node, but parallel search can, so a closed node is opened again
+void SearchContext::Open(NodeHandle node, float gScore, float fScore, NodeHandle previous) {
+    NodeRecord& record = Record(node);
+    record.gScore = gScore;
+    record.previous = previous;
+    record.closed = false;
+
+    m_openList.push_back(OpenEntry{ fScore, gScore, node });
+    std::push_heap(m_openList.begin(), m_openList.end(), HeapOrder);
+    m_peakOpenEntries = std::max(m_peakOpenEntries, m_openList.size());
+}
+
+// Pops entries until one refers to a node that has not been expanded yet
+NodeHandle SearchContext::PopOpen() {
+    while (!m_openList.empty()) {
+        std::pop_heap(m_openList.begin(), m_openList.end(), HeapOrder);
+        NodeHandle node = m_openList.back().node;
+        m_openList.pop_back();
+
+        NodeRecord& record = Record(node);
+        if (!record.closed) {
+            record.closed = true;
+            return node;
+        }
+    }
+    return InvalidNode;
+}
+
+bool SearchContext::IsClosed(NodeHandle node) const {
+    const NodeRecord* record = FindRecord(node);
+    return record != nullptr && record->closed;
+}
+
+float SearchContext::GetGScore(NodeHandle node) const {
+    const NodeRecord* record = FindRecord(node);
+    return record != nullptr ? record->gScore : FLT_MAX;
+}
+
+NodeHandle SearchContext::GetPrevious(NodeHandle node) const {
+    const NodeRecord* record = FindRecord(node);
+    return record != nullptr ? record->previous : InvalidNode;
+}
+
+// Peak usage counts only the records and open list entries this query actually touched,
+// not the capacity left over from larger earlier queries. Scratch above the retention limit
+// is released here, once the query no longer needs its records
+size_t SearchContext::End() {
+    size_t peakBytes = m_touchedRecords * sizeof(NodeRecord) + m_peakOpenEntries * sizeof(OpenEntry);
+    size_t limit = s_retentionLimit.load(std::memory_order_relaxed);
+    if (GetReservedBytes() > limit) {
+        Trim(limit);
+    }
+    UpdateReservedBytes();
+    return peakBytes;
+}
+
+// Releases pages the finished query did not touch first, since it is the best guide to where
+// the next one will search. Then the open list, which is a single allocation to grow back, and
+// only then the query's own pages. The page table itself is kept: it is small and sized by the
+// map rather than by the searches
+void SearchContext::Trim(size_t limitBytes) {
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1 && GetReservedBytes() > limitBytes) {
+            std::vector<OpenEntry>().swap(m_openList);
+        }
+        for (size_t chunk = 0; chunk < m_pages.size() && GetReservedBytes() > limitBytes; chunk++) {
+            bool touchedByLastQuery = m_pageGenerations[chunk] == m_generation;
+            if (m_pages[chunk] && (pass == 1 || !touchedByLastQuery)) {
+                m_pages[chunk].reset();
+                m_allocatedPages--;
+            }
+        }
+    }
+}
+
+// Only the owning thread writes its block, so plain loads and stores are enough; no
+// read-modify-write is needed
+void SearchContext::RecordSearch(size_t peakBytes, size_t expansions) {
+    m_stats.searches.store(m_stats.searches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_stats.expansions.store(m_stats.expansions.load(std::memory_order_relaxed) + expansions, std::memory_order_relaxed);
+    m_stats.lastPeakBytes.store(peakBytes, std::memory_order_relaxed);
+    m_stats.maxPeakBytes.store(std::max(m_stats.maxPeakBytes.load(std::memory_order_relaxed), peakBytes), std::memory_order_relaxed);
+    m_stats.lastSearchTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+size_t SearchContext::GetReservedBytes() const {
+    return m_openList.capacity() * sizeof(OpenEntry) +
+        m_pages.capacity() * sizeof(m_pages[0]) +
+        m_pageGenerations.capacity() * sizeof(unsigned int) +
+        m_allocatedPages * sizeof(RecordPage) +
+        m_pathBuffer.capacity() * sizeof(NodeHandle);
+}
+
+void SearchContext::UpdateReservedBytes() {
+    m_stats.reservedBytes.store(GetReservedBytes(), std::memory_order_relaxed);
+}
+
+size_t SearchContext::GetTotalReservedBytes() {
+    return GetMergedStats().reservedBytes;
+}
+
+void SearchContext::SetRetentionLimit(size_t bytes) {
+    s_retentionLimit.store(bytes, std::memory_order_relaxed);
+}
+
+size_t SearchContext::GetRetentionLimit() {
+    return s_retentionLimit.load(std::memory_order_relaxed);
+}
+
+// Sums the blocks of every context. Reads may land between a search's individual updates, so
+// a reading taken while searches run can be off by the searches in flight
+SearchStats SearchContext::GetMergedStats() {
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    SearchStats merged = s_retiredStats;
+    std::int64_t lastSearchTime = s_retiredLastSearchTime;
+    for (const SearchContext* context : s_liveContexts) {
+        const StatsBlock& stats = context->m_stats;
+        merged.searches += stats.searches.load(std::memory_order_relaxed);
+        merged.expansions += stats.expansions.load(std::memory_order_relaxed);
+        merged.maxPeakBytes = std::max(merged.maxPeakBytes, stats.maxPeakBytes.load(std::memory_order_relaxed));
+        merged.reservedBytes += stats.reservedBytes.load(std::memory_order_relaxed);
+        std::int64_t searchTime = stats.lastSearchTime.load(std::memory_order_relaxed);
+        if (searchTime > lastSearchTime) {
+            lastSearchTime = searchTime;
+            merged.lastPeakBytes = stats.lastPeakBytes.load(std::memory_order_relaxed);
+        }
+    }
+    return merged;
+}
+
+SearchContext& SearchContext::ForThisThread() {
+    // One context per thread, so concurrent searches never share scratch memory
+    thread_local SearchContext context;
+    return context;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cfloat>
+#include <atomic>
+#include <cstdint>
+#include "Pathfinding.h"
+#include "GridLayout.h"
+
+namespace AIForGames {
+
+    // Search statistics, merged over every thread's SearchContext by SearchContext::GetMergedStats()
+    struct SearchStats {
+        size_t searches{ 0 }; // Searches finished
+        size_t expansions{ 0 }; // Nodes expanded by those searches
+        size_t lastPeakBytes{ 0 }; // Scratch high-water mark of the most recent search
+        size_t maxPeakBytes{ 0 }; // Largest scratch high-water mark of any search
+        size_t reservedBytes{ 0 }; // Scratch currently held
+    };
+
+    // SearchContext holds every temporary an A* query needs: the open list, per-node scores
+    // and a buffer for the result path. It acts as a per-thread arena that is reset after each
+    // query: buffers keep their capacity, and per-node records are invalidated by bumping a
+    // generation counter instead of clearing them. Once a thread has searched a map, later
+    // searches on that map perform no heap allocations.
+    // Records are stored in pages of one map chunk each, allocated when a search first reaches
+    // that chunk, so scratch memory follows the area searched rather than the size of the map.
+    // Scratch beyond the retention limit is handed back when a query ends, so one huge search
+    // does not leave its pages held for the life of the thread.
+    // Each context also keeps its own statistics block. Pages and the block start on their own
+    // cache lines, so threads searching side by side never write to a shared line; the blocks
+    // are only summed when statistics are read.
+    class alignas(64) SearchContext
+    {
+        // Entry in the open list (a binary min-heap on fScore). Stale entries are skipped on pop
+        struct OpenEntry {
+            float fScore;
+            float gScore; // Breaks fScore ties in favour of nodes closer to the goal
+            NodeHandle node;
+        };
+
+        // Per-node search state, valid only when generation matches the current query
+        struct NodeRecord {
+            float gScore; // Cost from start node to this node
+            NodeHandle previous; // Previous node on the best known path
+            unsigned int generation; // Query that last wrote this record
+            bool closed; // True once the node has been expanded
+        };
+
+        // Records of one chunk, aligned so no two pages share a cache line
+        struct alignas(64) RecordPage {
+            NodeRecord records[GridLayout::ChunkCells];
+        };
+
+        // Statistics written by the owning thread only and read by GetMergedStats(). Relaxed
+        // atomics make those reads safe without any locked instruction on the search path
+        struct alignas(64) StatsBlock {
+            std::atomic<size_t> searches{ 0 };
+            std::atomic<size_t> expansions{ 0 };
+            std::atomic<size_t> lastPeakBytes{ 0 };
+            std::atomic<size_t> maxPeakBytes{ 0 };
+            std::atomic<size_t> reservedBytes{ 0 };
+            std::atomic<std::int64_t> lastSearchTime{ 0 }; // Clock ticks when the last search was recorded, to find the most recent one
+        };
+
+        std::vector<OpenEntry> m_openList; // Binary heap ordered by lowest fScore
+        std::vector<std::unique_ptr<RecordPage>> m_pages; // One page of records per map chunk, indexed by GridLayout::ChunkOf
+        std::vector<unsigned int> m_pageGenerations; // Query that last touched each page, to pick pages to release
+        std::vector<NodeHandle> m_pathBuffer; // Pooled buffer the result path is written into
+        unsigned int m_generation = 0; // Current query number
+        size_t m_allocatedPages = 0; // Pages allocated so far
+        size_t m_touchedRecords = 0; // Records written by the current query
+        size_t m_peakOpenEntries = 0; // Largest open list size in the current query
+        StatsBlock m_stats; // This context's statistics
+
+        NodeRecord& Record(NodeHandle node);
+        const NodeRecord* FindRecord(NodeHandle node) const; // Current query's record for a node, or nullptr
+        static bool HeapOrder(const OpenEntry& a, const OpenEntry& b);
+        void UpdateReservedBytes(); // Publishes capacity changes to the statistics block
+        void Trim(size_t limitBytes); // Releases scratch until no more than limitBytes are held
+
+    public:
+        SearchContext(); // Registers the context for GetMergedStats()
+        SearchContext(const SearchContext&) = delete;
+        SearchContext& operator=(const SearchContext&) = delete;
+        ~SearchContext(); // Folds the context's statistics into the merged totals
+
+        void Begin(size_t chunkCount); // Resets the context for a new query over a map with chunkCount chunks
+        void Open(NodeHandle node, float gScore, float fScore, NodeHandle previous); // Adds or improves a node on the open list (reopening it if closed)
+        NodeHandle PopOpen(); // Removes and closes the open node with the lowest fScore (InvalidNode when empty)
+        float PeekOpenFScore() const { return m_openList.empty() ? FLT_MAX : m_openList.front().fScore; } // Lowest fScore on the open list, possibly of a stale entry
+        bool IsClosed(NodeHandle node) const; // Returns true if the node was expanded this query
+        float GetGScore(NodeHandle node) const; // Returns the best known cost to the node (FLT_MAX if unseen)
+        NodeHandle GetPrevious(NodeHandle node) const; // Returns the node's predecessor on the best known path
+        std::vector<NodeHandle>& PathBuffer() { return m_pathBuffer; } // Pooled path storage owned by this thread
+        size_t End(); // Finishes the query and returns the scratch bytes it used at its peak
+        void RecordSearch(size_t peakBytes, size_t expansions); // Adds a finished search to this context's statistics
+        size_t GetReservedBytes() const; // Bytes currently held by this context's buffers
+
+        static size_t GetTotalReservedBytes(); // Bytes held by the search contexts of all threads
+        // Scratch each context may keep between queries; anything above it is released when a
+        // query ends. The default keeps the pages of a few hundred chunks
+        static void SetRetentionLimit(size_t bytes);
+        static size_t GetRetentionLimit();
+        static SearchStats GetMergedStats(); // Statistics of every context, live or destroyed
+        static SearchContext& ForThisThread(); // Returns the calling thread's context
+    };
+}
@@ -0,0 +1,286 @@
+#include "SubpathCache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+using namespace AIForGames;
+
+SubpathCache::SubpathCache(size_t capacityBytes) {
+    SetCapacity(capacityBytes);
+}
+
+// Postings are bounded by the capacity: a stored node is charged PostingBytes and a path that
+// overflows the cache is evicted right after it is added. Reserving for twice the capacity
+// therefore means neither the posting pool nor the index ever reallocates
+void SubpathCache::SetCapacity(size_t capacityBytes) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_capacityBytes.store(capacityBytes, std::memory_order_relaxed);
+    EvictToCapacity();
+    if (capacityBytes == 0) {
+        // Nothing is stored any more, so the buffers kept for reuse go too
+        for (std::uint32_t slot : m_freeSlots) {
+            m_paths[slot]->nodes = std::vector<NodeHandle>();
+        }
+        m_spareIndexNodes = std::vector<Index::node_type>();
+        m_postings = std::vector<Posting>();
+        m_freePostings = NoPosting;
+        m_largestPath = 0;
+        return;
+    }
+    size_t maxPostings = 2 * capacityBytes / (sizeof(NodeHandle) + PostingBytes);
+    m_postings.reserve(maxPostings);
+    m_index.reserve(maxPostings);
+}
+
+std::uint32_t SubpathCache::FirstPosting(NodeHandle node) const {
+    auto found = m_index.find(node);
+    return found != m_index.end() ? found->second : NoPosting;
+}
+
+// New postings go to the front of the node's list. Index entries and postings of removed paths
+// are reused before anything new is allocated
+void SubpathCache::AddPosting(NodeHandle node, std::uint32_t slot, std::uint32_t position) {
+    std::uint32_t posting = m_freePostings;
+    if (posting != NoPosting) {
+        m_freePostings = m_postings[posting].next;
+    }
+    else {
+        posting = static_cast<std::uint32_t>(m_postings.size());
+        m_postings.emplace_back();
+    }
+
+    auto found = m_index.find(node);
+    if (found == m_index.end()) {
+        if (m_spareIndexNodes.empty()) {
+            found = m_index.emplace(node, NoPosting).first;
+        }
+        else {
+            Index::node_type spare = std::move(m_spareIndexNodes.back());
+            m_spareIndexNodes.pop_back();
+            spare.key() = node;
+            spare.mapped() = NoPosting;
+            found = m_index.insert(std::move(spare)).position;
+        }
+    }
+    m_postings[posting] = { slot, position, found->second };
+    found->second = posting;
+}
+
+// Paths are simple (an optimal path never visits a node twice), so each stored path has at
+// most one posting per node and matching slots between the two lists is enough
+bool SubpathCache::FindSlice(NodeHandle start, NodeHandle goal, std::uint64_t version, std::vector<NodeHandle>& outPath) {
+    if (!IsEnabled()) return false;
+
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    m_lookups.fetch_add(1, std::memory_order_relaxed);
+    std::uint32_t startPostings = FirstPosting(start);
+    std::uint32_t goalPostings = startPostings != NoPosting ? FirstPosting(goal) : NoPosting;
+    if (goalPostings == NoPosting) return false;
+
+    for (std::uint32_t fromIndex = startPostings; fromIndex != NoPosting; fromIndex = m_postings[fromIndex].next) {
+        const Posting& from = m_postings[fromIndex];
+        StoredPath& stored = *m_paths[from.slot];
+        if (stored.version != version) continue;
+
+        for (std::uint32_t toIndex = goalPostings; toIndex != NoPosting; toIndex = m_postings[toIndex].next) {
+            const Posting& to = m_postings[toIndex];
+            if (to.slot != from.slot) continue;
+
+            if (from.position <= to.position) {
+                outPath.assign(stored.nodes.begin() + from.position, stored.nodes.begin() + to.position + 1);
+            }
+            else {
+                outPath.assign(stored.nodes.rbegin() + (stored.nodes.size() - 1 - from.position), stored.nodes.rend() - to.position);
+            }
+            stored.lastUsed.store(m_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+            m_sliceHits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Walks each stored path through start in both directions for as long as every step brings it
+// closer to the goal, and keeps the walk that ends nearest to it
+bool SubpathCache::FindTail(NodeHandle start, NodeHandle goal, std::uint64_t version, const GridLayout& layout, std::vector<NodeHandle>& outTail) {
+    if (!IsEnabled()) return false;
+
+    glm::ivec2 goalCoords = layout.ToCoords(goal);
+    auto distance = [&layout, goalCoords](NodeHandle node) {
+        glm::ivec2 diff = layout.ToCoords(node) - goalCoords;
+        return std::abs(diff.x) + std::abs(diff.y);
+        };
+
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::uint32_t startPostings = FirstPosting(start);
+    if (startPostings == NoPosting) return false;
+
+    StoredPath* best = nullptr;
+    std::uint32_t bestEnd = 0;
+    int bestDistance = distance(start);
+    std::uint32_t bestFrom = 0;
+    for (std::uint32_t fromIndex = startPostings; fromIndex != NoPosting; fromIndex = m_postings[fromIndex].next) {
+        const Posting& from = m_postings[fromIndex];
+        StoredPath& stored = *m_paths[from.slot];
+        if (stored.version != version) continue;
+
+        for (int step : { 1, -1 }) {
+            std::int64_t position = from.position;
+            int current = distance(start);
+            for (;;) {
+                std::int64_t next = position + step;
+                if (next < 0 || next >= static_cast<std::int64_t>(stored.nodes.size())) break;
+                int nextDistance = distance(stored.nodes[next]);
+                if (nextDistance >= current) break;
+                position = next;
+                current = nextDistance;
+            }
+            if (current < bestDistance) {
+                best = &stored;
+                bestFrom = from.position;
+                bestEnd = static_cast<std::uint32_t>(position);
+                bestDistance = current;
+            }
+        }
+    }
+    if (!best) return false;
+
+    outTail.clear();
+    if (bestFrom <= bestEnd) {
+        outTail.assign(best->nodes.begin() + bestFrom, best->nodes.begin() + bestEnd + 1);
+    }
+    else {
+        outTail.assign(best->nodes.rbegin() + (best->nodes.size() - 1 - bestFrom), best->nodes.rend() - bestEnd);
+    }
+    best->lastUsed.store(m_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    m_tailHits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// A path that is already a slice of a stored one adds nothing and is skipped
+void SubpathCache::Insert(const std::vector<NodeHandle>& path, std::uint64_t version) {
+    if (!IsEnabled() || path.size() < 2 || version < m_minVersion.load(std::memory_order_relaxed)) return;
+
+    size_t bytes = sizeof(StoredPath) + path.size() * (sizeof(NodeHandle) + PostingBytes);
+    if (bytes > m_capacityBytes.load(std::memory_order_relaxed)) return;
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::uint32_t startPostings = FirstPosting(path.front());
+    std::uint32_t goalPostings = startPostings != NoPosting ? FirstPosting(path.back()) : NoPosting;
+    for (std::uint32_t fromIndex = startPostings; goalPostings != NoPosting && fromIndex != NoPosting; fromIndex = m_postings[fromIndex].next) {
+        for (std::uint32_t toIndex = goalPostings; toIndex != NoPosting; toIndex = m_postings[toIndex].next) {
+            std::uint32_t slot = m_postings[fromIndex].slot;
+            if (slot == m_postings[toIndex].slot && m_paths[slot]->version == version) return;
+        }
+    }
+
+    std::uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<std::uint32_t>(m_paths.size());
+        m_paths.push_back(std::make_unique<StoredPath>());
+    }
+
+    // Every buffer is grown to the largest path seen as soon as it is reused, so once the
+    // lengths of stored paths settle no slot reallocates again, however short its last path was
+    StoredPath& stored = *m_paths[slot];
+    m_largestPath = std::max(m_largestPath, path.size());
+    if (stored.nodes.capacity() < m_largestPath) stored.nodes.reserve(m_largestPath);
+    stored.nodes.assign(path.begin(), path.end());
+    stored.version = version;
+    stored.bytes = bytes;
+    stored.lastUsed.store(m_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    for (size_t position = 0; position < path.size(); ++position) {
+        AddPosting(path[position], slot, static_cast<std::uint32_t>(position));
+    }
+    m_bytes += bytes;
+    m_insertions++;
+    EvictToCapacity();
+}
+
+void SubpathCache::InvalidateBefore(std::uint64_t version) {
+    std::uint64_t minVersion = m_minVersion.load();
+    while (version > minVersion && !m_minVersion.compare_exchange_weak(minVersion, version)) {}
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (std::uint32_t slot = 0; slot < m_paths.size(); ++slot) {
+        if (!m_paths[slot]->nodes.empty() && m_paths[slot]->version < version) {
+            Remove(slot);
+            m_invalidations++;
+        }
+    }
+}
+
+void SubpathCache::Remove(std::uint32_t slot) {
+    StoredPath& stored = *m_paths[slot];
+    for (NodeHandle node : stored.nodes) {
+        auto found = m_index.find(node);
+        if (found == m_index.end()) continue;
+        for (std::uint32_t* link = &found->second; *link != NoPosting;) {
+            std::uint32_t posting = *link;
+            if (m_postings[posting].slot != slot) {
+                link = &m_postings[posting].next;
+                continue;
+            }
+            *link = m_postings[posting].next;
+            m_postings[posting].next = m_freePostings;
+            m_freePostings = posting;
+        }
+        if (found->second == NoPosting) m_spareIndexNodes.push_back(m_index.extract(found));
+    }
+    m_bytes -= stored.bytes;
+    stored.nodes.clear();
+    stored.bytes = 0;
+    m_freeSlots.push_back(slot);
+}
+
+// Paths number in the hundreds at most, so a scan for the oldest is cheaper than keeping a
+// list in order on every lookup, which would need the write lock
+void SubpathCache::EvictToCapacity() {
+    size_t capacity = m_capacityBytes.load(std::memory_order_relaxed);
+    while (m_bytes > capacity) {
+        std::uint32_t oldest = 0;
+        std::uint64_t oldestTick = UINT64_MAX;
+        for (std::uint32_t slot = 0; slot < m_paths.size(); ++slot) {
+            std::uint64_t tick = m_paths[slot]->lastUsed.load(std::memory_order_relaxed);
+            if (!m_paths[slot]->nodes.empty() && tick < oldestTick) {
+                oldest = slot;
+                oldestTick = tick;
+            }
+        }
+        Remove(oldest);
+        m_evictions++;
+    }
+}
+
+SubpathCacheStats SubpathCache::GetStats() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    SubpathCacheStats stats;
+    stats.lookups = m_lookups.load(std::memory_order_relaxed);
+    stats.sliceHits = m_sliceHits.load(std::memory_order_relaxed);
+    stats.tailHits = m_tailHits.load(std::memory_order_relaxed);
+    stats.insertions = m_insertions;
+    stats.evictions = m_evictions;
+    stats.invalidations = m_invalidations;
+    stats.paths = m_paths.size() - m_freeSlots.size();
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+size_t SubpathCache::GetMemoryUsage() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    size_t bytes = m_bytes + m_index.bucket_count() * sizeof(void*) + m_spareIndexNodes.size() * PostingBytes + m_postings.capacity() * sizeof(Posting);
+    for (std::uint32_t slot : m_freeSlots) {
+        bytes += m_paths[slot]->nodes.capacity() * sizeof(NodeHandle);
+    }
+    return bytes;
+}
+
+void SubpathCacheStats::Print(std::ostream& out) const {
+    out << "[SUBPATH CACHE] " << sliceHits << " of " << lookups << " queries sliced from stored paths (" << SliceHitRate() * 100.0
+        << "%), " << tailHits << " searches seeded with a tail; " << insertions << " inserted, " << evictions << " evicted, "
+        << invalidations << " invalidated; " << paths << " paths, " << bytes / 1024 << " KB\n";
+}
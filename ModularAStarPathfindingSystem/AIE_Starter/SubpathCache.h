@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "Pathfinding.h"
+#include "GridLayout.h"
+
+namespace AIForGames {
+
+    // Counters of a SubpathCache
+    struct SubpathCacheStats {
+        size_t lookups{ 0 }; // Queries checked against the cache
+        size_t sliceHits{ 0 }; // Queries answered by slicing a stored path, with no search
+        size_t tailHits{ 0 }; // Searches seeded with the tail of a stored path
+        size_t insertions{ 0 }; // Paths stored
+        size_t evictions{ 0 }; // Paths dropped to stay within the capacity
+        size_t invalidations{ 0 }; // Paths dropped because the map changed
+        size_t paths{ 0 }; // Paths currently held
+        size_t bytes{ 0 }; // Memory charged to the stored paths and their index
+
+        double SliceHitRate() const { return lookups > 0 ? static_cast<double>(sliceHits) / lookups : 0.0; } // Share of queries needing no search
+        void Print(std::ostream& out) const; // Writes the counters as one console line
+    };
+
+    // SubpathCache reuses earlier optimal paths for any query that overlaps them. Every part of an
+    // optimal path is itself optimal, so the cache indexes stored paths by the nodes they pass
+    // through. If a query's start and goal both lie on one stored path it is answered by slicing
+    // that path, in either direction since connections are two-way with equal costs. If only the
+    // start lies on a stored path, FindTail() returns the stretch of it that heads straight for
+    // the goal; A* seeds its open list with those nodes at their exact costs, which keeps the
+    // result optimal while letting the search jump to the end of the stretch.
+    //
+    // Paths are tied to the map version they were found on. The cache is bounded in bytes and
+    // evicts the least recently used path. Lookups share a reader lock. Freed slots keep their
+    // buffers and the index keeps the nodes of removed entries, so once the cache has filled up
+    // storing a path does not allocate.
+    class SubpathCache
+    {
+    public:
+        explicit SubpathCache(size_t capacityBytes = 0); // 0 disables the cache
+        SubpathCache(const SubpathCache&) = delete;
+        SubpathCache& operator=(const SubpathCache&) = delete;
+
+        bool IsEnabled() const { return m_capacityBytes.load(std::memory_order_relaxed) > 0; } // False while the capacity is 0
+        void SetCapacity(size_t capacityBytes); // Changes the bound, evicting paths if needed; 0 disables and empties the cache
+        // Answers the query from a stored path of the same version if one passes through both ends.
+        // outPath receives the nodes from start to goal
+        bool FindSlice(NodeHandle start, NodeHandle goal, std::uint64_t version, std::vector<NodeHandle>& outPath);
+        // Finds the longest stretch of a stored path that starts at start and gets closer to the goal
+        // (by Manhattan distance) with every step. outTail receives it, start first. False if there is none
+        bool FindTail(NodeHandle start, NodeHandle goal, std::uint64_t version, const GridLayout& layout, std::vector<NodeHandle>& outTail);
+        void Insert(const std::vector<NodeHandle>& path, std::uint64_t version); // Stores an optimal path found on the given version
+        void InvalidateBefore(std::uint64_t version); // Drops every path of an older version
+        SubpathCacheStats GetStats() const; // Counters and current size
+        size_t GetMemoryUsage() const; // Bytes held by the stored paths and their index
+
+    private:
+        // Where a node appears: which stored path, and at which position on it. A node's postings
+        // form a list through m_postings, so storing a path never grows a per-node buffer
+        struct Posting {
+            std::uint32_t slot;
+            std::uint32_t position;
+            std::uint32_t next; // Next posting of the same node, or NoPosting
+        };
+        static constexpr std::uint32_t NoPosting = 0xFFFFFFFFu;
+
+        using Index = std::unordered_map<NodeHandle, std::uint32_t>; // First posting of each node
+
+        struct StoredPath {
+            std::vector<NodeHandle> nodes; // Empty for a free slot, which keeps the capacity for the next path
+            std::uint64_t version{ 0 };
+            size_t bytes{ 0 }; // Memory charged to the path and its postings
+            std::atomic<std::uint64_t> lastUsed{ 0 }; // Tick of the last lookup that used it, for LRU eviction
+        };
+
+        static constexpr size_t PostingBytes = sizeof(Posting) + 32; // Index cost per node, including the hash table entry
+
+        void Remove(std::uint32_t slot); // Frees a slot and its postings. Called with the write lock held
+        void EvictToCapacity(); // Drops least recently used paths until the cache fits. Called with the write lock held
+        std::uint32_t FirstPosting(NodeHandle node) const; // Head of a node's postings, or NoPosting
+        void AddPosting(NodeHandle node, std::uint32_t slot, std::uint32_t position); // Called with the write lock held
+
+        mutable std::shared_mutex m_mutex; // Shared by lookups, exclusive for changes
+        std::vector<std::unique_ptr<StoredPath>> m_paths; // Indexed by slot
+        std::vector<std::uint32_t> m_freeSlots; // Slots of removed paths, reused first
+        Index m_index; // Stored paths through each node
+        std::vector<Index::node_type> m_spareIndexNodes; // Removed index entries, reinserted for other nodes
+        std::vector<Posting> m_postings; // Every posting, linked per node; sized for the capacity when it is set
+        std::uint32_t m_freePostings{ NoPosting }; // Unused postings, linked through next
+        size_t m_largestPath{ 0 }; // Most nodes of any path stored, to which reused buffers grow
+        size_t m_bytes{ 0 }; // Memory charged to the stored paths
+        std::atomic<size_t> m_capacityBytes{ 0 };
+        std::atomic<std::uint64_t> m_tick{ 0 }; // Use counter for lastUsed
+        std::atomic<std::uint64_t> m_minVersion{ 0 }; // Oldest version still accepted by Insert()
+
+        // Counters updated under the reader lock, hence atomic
+        std::atomic<size_t> m_lookups{ 0 };
+        std::atomic<size_t> m_sliceHits{ 0 };
+        std::atomic<size_t> m_tailHits{ 0 };
+        size_t m_insertions{ 0 };
+        size_t m_evictions{ 0 };
+        size_t m_invalidations{ 0 };
+    };
+}
@@ -0,0 +1,68 @@
+#include "WaypointPath.h"
+#include "NodeMap.h"
+#include <cstdlib>
+
+using namespace AIForGames;
+
+namespace {
+    // Unit step (-1, 0 or 1 on each axis) from one cell towards another on the same row or column
+    glm::ivec2 StepTowards(glm::ivec2 from, glm::ivec2 to) {
+        return glm::ivec2((to.x > from.x) - (to.x < from.x), (to.y > from.y) - (to.y < from.y));
+    }
+}
+
+// Compresses a full node path by dropping every node that continues in the same direction
+void WaypointPath::Assign(const std::vector<NodeHandle>& path, const NodeMap& nodeMap) {
+    m_layout = nodeMap.GetLayout();
+    m_waypoints.clear();
+    if (path.empty()) return;
+
+    m_waypoints.push_back(path.front());
+    for (size_t i = 1; i + 1 < path.size(); i++) {
+        glm::ivec2 previous = m_layout.ToCoords(path[i - 1]);
+        glm::ivec2 current = m_layout.ToCoords(path[i]);
+        glm::ivec2 next = m_layout.ToCoords(path[i + 1]);
+        if (current - previous != next - current) {
+            m_waypoints.push_back(path[i]); // Direction changes here
+        }
+    }
+    if (path.size() > 1) {
+        m_waypoints.push_back(path.back());
+    }
+}
+
+size_t WaypointPath::size() const {
+    if (m_waypoints.empty()) return 0;
+
+    // Each straight segment adds one node per cell travelled
+    size_t count = 1;
+    for (size_t i = 1; i < m_waypoints.size(); i++) {
+        glm::ivec2 delta = m_layout.ToCoords(m_waypoints[i]) - m_layout.ToCoords(m_waypoints[i - 1]);
+        count += std::abs(delta.x) + std::abs(delta.y);
+    }
+    return count;
+}
+
+WaypointPath::Iterator WaypointPath::begin() const {
+    if (m_waypoints.empty()) return end();
+    return Iterator(this, 0, m_waypoints.front());
+}
+
+WaypointPath::Iterator& WaypointPath::Iterator::operator++() {
+    const std::vector<NodeHandle>& waypoints = m_path->m_waypoints;
+    if (m_segment + 1 >= waypoints.size()) {
+        // Stepped past the final waypoint
+        *this = m_path->end();
+        return *this;
+    }
+
+    const GridLayout& layout = m_path->m_layout;
+    NodeHandle target = waypoints[m_segment + 1];
+    glm::ivec2 current = layout.ToCoords(m_node);
+    glm::ivec2 next = current + StepTowards(current, layout.ToCoords(target));
+    m_node = layout.ToHandle(next.x, next.y);
+    if (m_node == target) {
+        m_segment++; // Reached a turning point, the next step follows the new segment
+    }
+    return *this;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <iterator>
+#include "Pathfinding.h"
+#include "GridLayout.h"
+
+namespace AIForGames {
+
+    class NodeMap;
+
+    // WaypointPath is a compact route through a NodeMap. Instead of every node on the route it
+    // keeps only the start, the end and the nodes where the direction of travel changes. Long
+    // straight corridors collapse to two entries. Iterating the path expands each straight
+    // segment one node at a time, so callers that need every node still see all of them.
+    // Segments are assumed to follow the map's orthogonal grid connections. The path keeps a copy of
+    // the map's GridLayout, so it is a self-contained value that needs no map to be expanded.
+    class WaypointPath
+    {
+        std::vector<NodeHandle> m_waypoints; // Start, turning points and end of the route
+        GridLayout m_layout; // Handle encoding of the map, used to step between waypoints
+
+    public:
+        // Forward iterator that walks every node on the route, expanding segments lazily
+        class Iterator
+        {
+            const WaypointPath* m_path{ nullptr };
+            size_t m_segment{ 0 }; // Index of the waypoint the current segment starts from
+            NodeHandle m_node{ InvalidNode }; // Current node (InvalidNode at the end)
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = NodeHandle;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const NodeHandle*;
+            using reference = NodeHandle;
+
+            Iterator() = default;
+            Iterator(const WaypointPath* path, size_t segment, NodeHandle node) : m_path(path), m_segment(segment), m_node(node) {}
+            NodeHandle operator*() const { return m_node; } // Returns the node at the current position
+            Iterator& operator++(); // Advances to the next node on the route
+            Iterator operator++(int) { Iterator previous = *this; ++(*this); return previous; }
+            bool operator==(const Iterator& other) const { return m_path == other.m_path && m_node == other.m_node && m_segment == other.m_segment; }
+            bool operator!=(const Iterator& other) const { return !(*this == other); }
+        };
+
+        WaypointPath() = default;
+        WaypointPath(const std::vector<NodeHandle>& path, const NodeMap& nodeMap) { Assign(path, nodeMap); } // Compresses a full node path
+        void Assign(const std::vector<NodeHandle>& path, const NodeMap& nodeMap); // Replaces the contents, reusing existing capacity
+        void clear() { m_waypoints.clear(); } // Removes all waypoints
+        void Reserve(size_t waypoints) { m_waypoints.reserve(waypoints); } // Makes room for this many waypoints without reallocating
+        bool empty() const { return m_waypoints.empty(); } // True if there is no route
+        size_t size() const; // Number of nodes on the expanded route
+        size_t WaypointCount() const { return m_waypoints.size(); } // Number of stored waypoints
+        NodeHandle GetWaypoint(size_t index) const { return m_waypoints[index]; } // Returns a stored waypoint
+        const std::vector<NodeHandle>& GetWaypoints() const { return m_waypoints; } // All stored waypoints, in order
+        size_t GetMemoryUsage() const { return sizeof(*this) + m_waypoints.capacity() * sizeof(NodeHandle); } // Bytes held by this path
+        NodeHandle Front() const { return m_waypoints.empty() ? InvalidNode : m_waypoints.front(); } // First node on the route
+        NodeHandle Back() const { return m_waypoints.empty() ? InvalidNode : m_waypoints.back(); } // Last node on the route
+        Iterator begin() const; // Iterator to the first node
+        Iterator end() const { return Iterator(this, m_waypoints.size(), InvalidNode); } // Iterator past the last node
+    };
+}
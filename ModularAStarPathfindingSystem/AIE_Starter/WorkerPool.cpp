@@ -0,0 +1,187 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+using namespace AIForGames;
+
+WorkerPool::WorkerPool(unsigned int workerCount) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_workerCount = workerCount;
+    m_ranges = std::make_unique<WorkRange[]>(workerCount);
+
+    m_threads.reserve(workerCount - 1);
+    for (unsigned int worker = 1; worker < workerCount; worker++) {
+        m_threads.emplace_back(&WorkerPool::ThreadLoop, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    // Posted tasks may still use the workers, so they finish first
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_postStopping = true;
+    }
+    m_postWake.notify_all();
+    if (m_postThread.joinable()) {
+        m_postThread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+WorkerPool& WorkerPool::Shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::ParallelFor(size_t count, const IndexTask& task) {
+    if (count == 0) return;
+    if (count > std::numeric_limits<std::uint32_t>::max()) {
+        std::cerr << "Error: ParallelFor supports at most " << std::numeric_limits<std::uint32_t>::max() << " indices." << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+
+    // Hand every worker an equal contiguous share; stealing evens out the rest
+    std::uint64_t total = count;
+    for (unsigned int worker = 0; worker < m_workerCount; worker++) {
+        std::uint64_t begin = total * worker / m_workerCount;
+        std::uint64_t end = total * (worker + 1) / m_workerCount;
+        m_ranges[worker].bounds.store(begin << 32 | end, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_busyThreads = static_cast<unsigned int>(m_threads.size());
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunWorker(0);
+
+    // Wait for the pool threads, so the task and its captures outlive every call
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this] { return m_busyThreads == 0; });
+    m_task = nullptr;
+}
+
+bool WorkerPool::TakeFront(WorkRange& range, std::uint32_t& index) {
+    std::uint64_t bounds = range.bounds.load(std::memory_order_acquire);
+    for (;;) {
+        std::uint32_t begin = static_cast<std::uint32_t>(bounds >> 32);
+        std::uint32_t end = static_cast<std::uint32_t>(bounds);
+        if (begin >= end) return false;
+        if (range.bounds.compare_exchange_weak(bounds, std::uint64_t(begin + 1) << 32 | end, std::memory_order_acq_rel)) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+// Splits the victim's remaining range in two and takes the back half, leaving the front to its
+// owner. A single remaining index is taken whole
+bool WorkerPool::StealBack(WorkRange& range, std::uint32_t& begin, std::uint32_t& end) {
+    std::uint64_t bounds = range.bounds.load(std::memory_order_acquire);
+    for (;;) {
+        std::uint32_t victimBegin = static_cast<std::uint32_t>(bounds >> 32);
+        std::uint32_t victimEnd = static_cast<std::uint32_t>(bounds);
+        if (victimBegin >= victimEnd) return false;
+        std::uint32_t middle = victimBegin + (victimEnd - victimBegin) / 2;
+        if (range.bounds.compare_exchange_weak(bounds, std::uint64_t(victimBegin) << 32 | middle, std::memory_order_acq_rel)) {
+            begin = middle;
+            end = victimEnd;
+            return true;
+        }
+    }
+}
+
+// A worker finishes when its own range is empty and a full pass over the other workers finds
+// nothing to steal. Work is never lost: a stolen range is always processed by its thief
+void WorkerPool::RunWorker(unsigned int worker) {
+    const IndexTask& task = *m_task;
+    WorkRange& own = m_ranges[worker];
+    for (;;) {
+        std::uint32_t index;
+        while (TakeFront(own, index)) {
+            task(index, worker);
+        }
+
+        bool stole = false;
+        for (unsigned int offset = 1; offset < m_workerCount && !stole; offset++) {
+            std::uint32_t begin, end;
+            if (StealBack(m_ranges[(worker + offset) % m_workerCount], begin, end)) {
+                own.bounds.store(std::uint64_t(begin) << 32 | end, std::memory_order_release);
+                stole = true;
+            }
+        }
+        if (!stole) return;
+    }
+}
+
+void WorkerPool::ThreadLoop(unsigned int worker) {
+    std::uint64_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) return;
+            seenGeneration = m_generation;
+        }
+
+        RunWorker(worker);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyThreads == 0) {
+            m_finished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::Post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        if (!m_postThread.joinable()) {
+            m_postThread = std::thread(&WorkerPool::PostedLoop, this);
+        }
+        m_posted.push_back(std::move(task));
+        m_postedCount++;
+    }
+    m_postWake.notify_one();
+}
+
+void WorkerPool::WaitForPosted() {
+    std::unique_lock<std::mutex> lock(m_postMutex);
+    std::uint64_t target = m_postedCount;
+    m_postIdle.wait(lock, [&] { return m_postedFinished >= target; });
+}
+
+// Runs each task outside the lock, so a task may post more work. Tasks still queued at
+// shutdown are run before the thread exits
+void WorkerPool::PostedLoop() {
+    std::unique_lock<std::mutex> lock(m_postMutex);
+    for (;;) {
+        m_postWake.wait(lock, [this] { return m_postStopping || !m_posted.empty(); });
+        if (m_posted.empty()) return;
+
+        Task task = std::move(m_posted.front());
+        m_posted.pop_front();
+        lock.unlock();
+        task();
+        task = nullptr; // Captures are released before waiters are told the task is done
+        lock.lock();
+        m_postedFinished++;
+        m_postIdle.notify_all();
+    }
+}
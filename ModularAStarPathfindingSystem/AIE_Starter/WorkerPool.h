@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AIForGames {
+
+    // WorkerPool is a fork-join pool of persistent threads for data-parallel work such as batch
+    // searches. ParallelFor() splits an index range evenly between the workers. Each worker
+    // consumes its own range from the front, and a worker that runs dry steals the back half of
+    // another worker's range, so uneven work (a few long searches among many short ones) still
+    // keeps every core busy. The calling thread joins in as worker 0, and the call returns once
+    // every index has been processed.
+    //
+    // Tasks must not call ParallelFor() on the same pool again; concurrent calls from different
+    // threads are run one after the other.
+    //
+    // Work that nobody waits for, such as rebuilding a table after a map edit, is posted with
+    // Post(). Posted tasks run one at a time, in order, on a background thread the pool starts
+    // on first use, and may call ParallelFor() on the pool like any other thread.
+    class WorkerPool
+    {
+    public:
+        using IndexTask = std::function<void(size_t index, unsigned int worker)>; // Processes one index on the given worker
+        using Task = std::function<void()>; // Background work queued by Post()
+
+        explicit WorkerPool(unsigned int workerCount = 0); // 0 uses every hardware thread (including the caller)
+        ~WorkerPool();
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        void ParallelFor(size_t count, const IndexTask& task); // Runs task for every index in [0, count)
+        void Post(Task task); // Queues task for the background thread and returns straight away
+        void WaitForPosted(); // Returns once every task posted so far has finished
+        unsigned int GetWorkerCount() const { return m_workerCount; } // Workers, including the calling thread
+        static WorkerPool& Shared(); // Process-wide pool, created on first use
+
+    private:
+        // One worker's remaining indices, packed as (begin << 32 | end) so the owner and thieves
+        // can update both ends with a single compare-and-swap. Padded to a cache line so
+        // workers do not invalidate each other's ranges
+        struct alignas(64) WorkRange {
+            std::atomic<std::uint64_t> bounds{ 0 };
+        };
+
+        static bool TakeFront(WorkRange& range, std::uint32_t& index); // Owner: takes the next index
+        static bool StealBack(WorkRange& range, std::uint32_t& begin, std::uint32_t& end); // Thief: takes the back half
+        void RunWorker(unsigned int worker); // Processes indices until no worker has any left
+        void ThreadLoop(unsigned int worker); // Body of each pool thread
+        void PostedLoop(); // Body of the background thread
+
+        unsigned int m_workerCount; // Pool threads plus the calling thread
+        std::unique_ptr<WorkRange[]> m_ranges; // One range per worker
+        std::vector<std::thread> m_threads; // Workers 1 to N-1; the caller is worker 0
+        std::mutex m_runMutex; // Serialises ParallelFor() calls
+        std::mutex m_mutex; // Guards the fields below
+        std::condition_variable m_wake; // Signals a new task (or shutdown) to the pool threads
+        std::condition_variable m_finished; // Signals the caller that every pool thread is done
+        const IndexTask* m_task{ nullptr }; // Task of the running ParallelFor()
+        std::uint64_t m_generation{ 0 }; // Incremented for every ParallelFor(), so threads run each task once
+        unsigned int m_busyThreads{ 0 }; // Pool threads still working on the current task
+        bool m_stopping{ false }; // Set by the destructor
+
+        std::mutex m_postMutex; // Guards the fields below
+        std::condition_variable m_postWake; // Signals a posted task (or shutdown) to the background thread
+        std::condition_variable m_postIdle; // Signals WaitForPosted() that the queue has drained
+        std::deque<Task> m_posted; // Tasks waiting to run, oldest first
+        std::uint64_t m_postedCount{ 0 }; // Tasks posted so far
+        std::uint64_t m_postedFinished{ 0 }; // Tasks finished so far
+        std::thread m_postThread; // Background thread, started by the first Post()
+        bool m_postStopping{ false }; // Set by the destructor once the queue should drain and stop
+    };
+}